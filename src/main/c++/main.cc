@@ -50,10 +50,14 @@ int main( int argc, char * argv[] ) {
 
     Option version( "-version", "P", Option::NO_VALUE_REQUIRED );
     Option param_file( "-parameters", "", Option::VALUE_REQUIRED );
+    Option save_file( "-save", "", Option::VALUE_REQUIRED );
+    Option load_file( "-load", "", Option::VALUE_REQUIRED );
 
     vector<Option*> prog_options;
     prog_options.push_back( &version );
     prog_options.push_back( &param_file );
+    prog_options.push_back( &save_file );
+    prog_options.push_back( &load_file );
 
     // retrieve the command line options
 
@@ -73,10 +77,14 @@ int main( int argc, char * argv[] ) {
 
     parameters.load( param_file.get_value() );
 
+    // Without a file of saved discriminators, they are learned anew
+    bool learning = load_file.get_value().empty();
+
     // Read the data
     fprintf(stderr,"\n----%s----\n\n","reading data" );
 
-    if ( !parameters.contains_property( string("Data::Training::Filename") ) ) {
+    if ( learning &&
+         !parameters.contains_property( string("Data::Training::Filename") ) ) {
         string msg =
             "Property \"Data::Training::Filename\" not found in file: " +
                     param_file.get_value();
@@ -88,13 +96,15 @@ int main( int argc, char * argv[] ) {
 
     dataManager.init( parameters );
 
-    fprintf(stderr,"\n----%s----\n\n","loading the training data" );
-    dataManager.load_training_data(
+    if ( learning ) {
+        fprintf(stderr,"\n----%s----\n\n","loading the training data" );
+        dataManager.load_training_data(
             parameters.get_property( string("Data::Training::Filename") ) );
 
-    fprintf(stderr,"\n----%s----\n\n","loading the test data" );
-    dataManager.load_test_data(
+        fprintf(stderr,"\n----%s----\n\n","loading the test data" );
+        dataManager.load_test_data(
             parameters.get_property( string("Data::Testing::Filename") ) );
+    }
 
     // Initialize the stochastic discrimination machine
     fprintf(stderr,"----%s----\n\n","initializing SDM" );
@@ -103,20 +113,30 @@ int main( int argc, char * argv[] ) {
 
     sdm.init( parameters );
 
-    // Learn the training data
-    fprintf(stderr,"----%s----\n\n","learning" );
+    if ( learning ) {
+        // Learn the training data
+        fprintf(stderr,"----%s----\n\n","learning" );
 
-    double realTime;
-    double cpuTime;
-    Timer timer;
+        double realTime;
+        double cpuTime;
+        Timer timer;
 
-    sdm.learn( dataManager );
+        sdm.learn( dataManager );
 
-    timer.elapsed( realTime, cpuTime );
+        timer.elapsed( realTime, cpuTime );
 
-    fprintf(stderr,"%s %.4f s\n", "real time: ", realTime);
-    fprintf(stderr,"%s %.4f s\n", "cpu time: ", cpuTime);
-    fprintf(stderr,"%s %.4f\n", "speed up: ", cpuTime/realTime);
+        fprintf(stderr,"%s %.4f s\n", "real time: ", realTime);
+        fprintf(stderr,"%s %.4f s\n", "cpu time: ", cpuTime);
+        fprintf(stderr,"%s %.4f\n", "speed up: ", cpuTime/realTime);
+
+        if ( !save_file.get_value().empty() ) {
+            fprintf(stderr,"\n----%s----\n\n","saving the discriminators" );
+            sdm.save( save_file.get_value(), dataManager );
+        }
+    } else {
+        fprintf(stderr,"----%s----\n\n","loading the discriminators" );
+        sdm.load( load_file.get_value(), dataManager );
+    }
 
     fprintf(stderr,"\n----%s----\n\n","loading the trial data" );
 
@@ -20,22 +20,100 @@
 #include <cmath>
 #include <cstdio>
 #include <limits>
+#include <new>
 #include <set>
+#include <vector>
+
+#include "noir/point_columns.h"
 
 namespace noir {
 
 using std::set;
+using std::vector;
+
+Ball::Ball( const NoirSpace *noir_space, const double &radius,
+            util::Arena *arena ) : 
+            Point(noir_space, arena != 0 ? 
+                    arena->allocate( Point::storage_size( noir_space ), 
+                                     alignof(double) ) : 0 ), 
+            radius(radius), allowed_nominals(0), ownedStorage(0) {
 
-Ball::Ball( const NoirSpace *noir_space, const double &radius ) : 
-            Point(noir_space), radius(radius) {
-    allowed_nominals = new set<int>[noirSpace->nominal];
+    size_t size = noirSpace->nominal*sizeof(set<int>);
+    char *storage = 0;
+    if ( arena != 0 ) {
+        storage = static_cast<char*>( arena->allocate( size, 
+                                                    alignof(set<int>) ) );
+    } else {
+        storage = ownedStorage = new char[size];
+    }
+
+    allowed_nominals = reinterpret_cast<set<int>*>( storage );
     for ( int n = 0; n < noirSpace->nominal; ++n ) {
-        allowed_nominals[n].clear();
+        new (allowed_nominals + n) set<int>();
     }
 }
 
 Ball::~Ball() {
-    delete[] allowed_nominals;
+    for ( int n = 0; n < noirSpace->nominal; ++n ) {
+        allowed_nominals[n].~set<int>();
+    }
+
+    delete[] ownedStorage;
+}
+
+void Ball::write( util::BinaryWriter &out ) const {
+    out.write_double( radius );
+    out.write( get_nominal_coordinates(), noirSpace->nominal*sizeof(int) );
+    out.write( get_ordinal_coordinates(), 
+               noirSpace->ordinal*sizeof(double) );
+    out.write( get_interval_coordinates(), 
+               noirSpace->interval*sizeof(double) );
+    out.write( get_real_coordinates(), noirSpace->real*sizeof(double) );
+
+    for ( int n = 0; n < noirSpace->nominal; ++n ) {
+        out.write_int( allowed_nominals[n].size() );
+        set<int>::const_iterator sit;
+        for ( sit = allowed_nominals[n].begin(); 
+              sit != allowed_nominals[n].end(); ++sit ) {
+            out.write_int( *sit );
+        }
+    }
+}
+
+void Ball::read( util::BinaryReader &in ) {
+    radius = in.read_double();
+
+    // The interval coordinates are set one by one, to update their sines
+    // and cosines as well
+    vector<int> nominals( noirSpace->nominal );
+    vector<double> ordinals( noirSpace->ordinal );
+    vector<double> intervals( noirSpace->interval );
+    vector<double> reals( noirSpace->real );
+    in.read( nominals.data(), nominals.size()*sizeof(int) );
+    in.read( ordinals.data(), ordinals.size()*sizeof(double) );
+    in.read( intervals.data(), intervals.size()*sizeof(double) );
+    in.read( reals.data(), reals.size()*sizeof(double) );
+
+    for ( int n = 0; n < noirSpace->nominal; ++n ) {
+        set_nominal_coordinate( n, nominals[n] );
+    }
+    for ( int o = 0; o < noirSpace->ordinal; ++o ) {
+        set_ordinal_coordinate( o, ordinals[o] );
+    }
+    for ( int i = 0; i < noirSpace->interval; ++i ) {
+        set_interval_coordinate( i, intervals[i] );
+    }
+    for ( int r = 0; r < noirSpace->real; ++r ) {
+        set_real_coordinate( r, reals[r] );
+    }
+
+    for ( int n = 0; n < noirSpace->nominal; ++n ) {
+        allowed_nominals[n].clear();
+        int64_t num_values = in.read_int();
+        for ( int64_t v = 0; v < num_values; ++v ) {
+            allowed_nominals[n].insert( static_cast<int>(in.read_int()) );
+        }
+    }
 }
 
 bool Ball::in_closure( const Point *point ) const {
@@ -57,5 +135,28 @@ bool Ball::in_closure( const Point *point ) const {
         return true;
 }
 
+void Ball::in_closure( const PointColumns &points, const size_t &begin,
+                       const size_t &end, char *inside ) const {
+    const size_t num_points = end - begin;
+    if ( num_points == 0 ) return;
+
+    vector<double> dist( num_points );
+    noirSpace->norm( this, points, begin, end, &dist[0] );
+
+    for ( int n = 0; n < noirSpace->nominal; ++n ) {
+        int const *p_nominals = points.get_nominal_column(n) + begin;
+        for ( size_t k = 0; k < num_points; ++k ) {
+            if ( allowed_nominals[n].find(p_nominals[k]) !=
+                                            allowed_nominals[n].end() ) {
+                dist[k] -= 1.0;
+            }
+        }
+    }
+
+    double epsilon = 1.0e-3;
+    for ( size_t k = 0; k < num_points; ++k ) {
+        inside[k] = ( dist[k] - radius > epsilon ) ? 0 : 1;
+    }
+}
 
 }  // namespace noir
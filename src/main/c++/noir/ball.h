@@ -21,6 +21,8 @@
 
 #include "noir/noir_space.h"
 #include "noir/point.h"
+#include "util/arena.h"
+#include "util/binary_file.h"
 
 
 namespace noir {
@@ -29,9 +31,14 @@ namespace noir {
  * An Ball in Noir Space is defined by a point, a radius and the metric used
  * to define the space.
  */
-class Ball : public Point, public ClosedSpace {
+class Ball final : public Point, public ClosedSpace {
  public:
-    Ball(const NoirSpace *noirSpace, const double &radius); 
+    /*
+     * Creates a ball of the specified radius. If an arena is specified, all
+     * of the ball's storage is taken from it.
+     */
+    Ball(const NoirSpace *noirSpace, const double &radius,
+         util::Arena *arena = 0); 
 
     virtual ~Ball();
 
@@ -55,6 +62,14 @@ class Ball : public Point, public ClosedSpace {
      */
     bool in_closure( const Point *point ) const;
 
+    /*
+     * Determines, for each of the points [begin,end) of the specified
+     * columns, whether or not it is contained within the closure of this
+     * ball. The answer for point begin+k is stored in inside[k].
+     */
+    void in_closure( const PointColumns &points, const size_t &begin,
+                     const size_t &end, char *inside ) const;
+
     /*
      * Adds a nominal value to the set of values for the specified coordinate.
      */
@@ -69,9 +84,22 @@ class Ball : public Point, public ClosedSpace {
         return allowed_nominals[coordinate];
     }
 
+    /*
+     * Writes this ball: its radius, its centre and, for each nominal
+     * coordinate, the number of values allowed followed by the values.
+     */
+    void write( util::BinaryWriter &out ) const;
+
+    /*
+     * Reads a ball written by write into this one, which must live in a
+     * space of the same dimensions.
+     */
+    void read( util::BinaryReader &in );
+
  private:
     double radius;
     std::set<int> *allowed_nominals;
+    char *ownedStorage;
 
     Ball(const Point&) = delete;
     Ball& operator=(const Ball&) = delete;
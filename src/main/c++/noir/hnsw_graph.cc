@@ -0,0 +1,339 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "noir/hnsw_graph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <vector>
+
+namespace noir {
+
+using std::vector;
+
+namespace {
+
+// The highest layer of a graph
+const int MAX_LEVEL = 16;
+
+// The points are inserted in batches of this fraction of the points already
+// in the graph, so that the points of a batch rarely are among the nearest
+// neighbours of each other, which they cannot find
+const size_t BATCH_DIVISOR = 32;
+
+// The number of points of a batch searched by a task
+const size_t SEARCHES_PER_TASK = 16;
+
+// Draws the layer of the point at the specified position from a geometric
+// distribution, so that each layer holds about 1/max_neighbors of the points
+// of the layer below. The random number is a hash of the position.
+int draw_level( const size_t &position, const int &max_neighbors ) {
+    uint64_t z = static_cast<uint64_t>(position) + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z = z ^ (z >> 31);
+    double u = static_cast<double>((z >> 11) + 1)/9007199254740992.0;
+    int level = static_cast<int>( -log( u )/log( max_neighbors ) );
+    return std::min( level, MAX_LEVEL );
+}
+
+// Marks of the points visited by the searches of a thread. A point counts as
+// visited if its mark equals the number of the current search, so the marks
+// need not be cleared between searches.
+struct Visits {
+    vector<unsigned> marks;
+    unsigned search;
+
+    void start( const size_t &num_points ) {
+        if ( marks.size() < num_points ) marks.resize( num_points, 0 );
+        if ( ++search == 0 ) {
+            std::fill( marks.begin(), marks.end(), 0 );
+            search = 1;
+        }
+    }
+
+    // Marks the specified point and tells whether it was unmarked before
+    bool visit( const int &point ) {
+        if ( marks[point] == search ) return false;
+        marks[point] = search;
+        return true;
+    }
+};
+
+thread_local Visits visits;
+
+}  // namespace
+
+HNSWGraph::HNSWGraph( const vector<const Point*> &points,
+                      util::ThreadPool *thread_pool,
+                      const int &max_neighbors, const int &ef_construction ) :
+                      points(points), 
+                      maxNeighbors( std::max( max_neighbors, 2 ) ),
+                      efConstruction( std::max( ef_construction, 1 ) ),
+                      entry(-1), topLevel(0), levels( points.size() ),
+                      links(), upperOffset( points.size(), -1 ), 
+                      upperLinks() {
+    size_t upper_size = 0;
+    for ( size_t p = 0; p < points.size(); ++p ) {
+        levels[p] = draw_level( p, maxNeighbors );
+        if ( levels[p] > 0 ) {
+            upperOffset[p] = static_cast<int>(upper_size);
+            upper_size += levels[p]*(capacity(1) + 1);
+        }
+    }
+    links.assign( points.size()*(capacity(0) + 1), 0 );
+    upperLinks.assign( upper_size, 0 );
+
+    // The searches only read the graph and write their own insertion
+    vector<Insertion> batch;
+    size_t num_inserted = 0;
+    auto search_batch = [&]( size_t begin, size_t end ){
+        for ( size_t k = begin; k < end; ++k ) {
+            batch[k].point = static_cast<int>(num_inserted + k);
+            search( batch[k] );
+        }
+    };
+
+    while ( num_inserted < points.size() ) {
+        size_t count = std::min( std::max( num_inserted/BATCH_DIVISOR, 
+                                           static_cast<size_t>(1) ),
+                                 points.size() - num_inserted );
+        batch.resize( count );
+        if ( thread_pool == 0 ) {
+            search_batch( 0, count );
+        } else {
+            thread_pool->parallel_for( 0, count, SEARCHES_PER_TASK, 
+                                       search_batch );
+        }
+
+        for ( size_t k = 0; k < count; ++k ) {
+            link( batch[k] );
+        }
+        num_inserted += count;
+    }
+}
+
+int* HNSWGraph::get_links( const int &point, const int &level ) {
+    if ( level == 0 ) return &links[point*(capacity(0) + 1)];
+    return &upperLinks[upperOffset[point] + (level - 1)*(capacity(1) + 1)];
+}
+
+const int* HNSWGraph::get_links( const int &point, const int &level ) const {
+    if ( level == 0 ) return &links[point*(capacity(0) + 1)];
+    return &upperLinks[upperOffset[point] + (level - 1)*(capacity(1) + 1)];
+}
+
+void HNSWGraph::search( Insertion &insertion ) const {
+    insertion.neighbors.clear();
+    if ( entry < 0 ) return;
+
+    int level = levels[insertion.point];
+    const Point *query = points[insertion.point];
+    const Norm &norm = query->noirSpace->norm;
+
+    Candidate nearest = { norm( query, points[entry] ), entry };
+    for ( int l = topLevel; l > level; --l ) {
+        descend( query, nearest, l );
+    }
+
+    // On each of its layers the point is to be linked to neighbours chosen
+    // from the beam, which then seeds the search on the layer below
+    insertion.neighbors.resize( std::min( level, topLevel ) + 1 );
+    vector<Candidate> found( 1, nearest );
+    for ( int l = std::min( level, topLevel ); l >= 0; --l ) {
+        search_layer( query, found, efConstruction, l );
+
+        insertion.neighbors[l] = found;
+        select_neighbors( insertion.neighbors[l], maxNeighbors );
+    }
+}
+
+void HNSWGraph::link( const Insertion &insertion ) {
+    int point = insertion.point;
+    int level = levels[point];
+    if ( entry < 0 ) {
+        entry = point;
+        topLevel = level;
+        return;
+    }
+
+    for ( size_t l = 0; l < insertion.neighbors.size(); ++l ) {
+        const vector<Candidate> &neighbors = insertion.neighbors[l];
+        int *point_links = get_links( point, static_cast<int>(l) );
+        point_links[0] = static_cast<int>(neighbors.size());
+        for ( size_t k = 0; k < neighbors.size(); ++k ) {
+            point_links[k + 1] = neighbors[k].point;
+            Candidate back = { neighbors[k].dist, point };
+            connect( neighbors[k].point, back, static_cast<int>(l) );
+        }
+    }
+
+    if ( level > topLevel ) {
+        entry = point;
+        topLevel = level;
+    }
+}
+
+void HNSWGraph::descend( const Point *query, Candidate &nearest, 
+                         const int &level ) const {
+    const Norm &norm = query->noirSpace->norm;
+    bool moved = true;
+    while ( moved ) {
+        moved = false;
+        const int *point_links = get_links( nearest.point, level );
+        for ( int k = 1; k <= point_links[0]; ++k ) {
+            Candidate next = { norm( query, points[point_links[k]] ), 
+                               point_links[k] };
+            if ( next < nearest ) {
+                nearest = next;
+                moved = true;
+            }
+        }
+    }
+}
+
+void HNSWGraph::search_layer( const Point *query, vector<Candidate> &found,
+                              const int &ef, const int &level ) const {
+    const Norm &norm = query->noirSpace->norm;
+    const size_t beam = static_cast<size_t>(ef);
+
+    visits.start( points.size() );
+    std::priority_queue<Candidate, vector<Candidate>, 
+                        std::greater<Candidate> > candidates;
+    std::priority_queue<Candidate> nearest;
+    for ( size_t k = 0; k < found.size(); ++k ) {
+        visits.visit( found[k].point );
+        candidates.push( found[k] );
+        nearest.push( found[k] );
+        if ( nearest.size() > beam ) nearest.pop();
+    }
+
+    // Expand the nearest unexpanded candidate until it is farther away than
+    // all of the points in the beam
+    while ( !candidates.empty() ) {
+        Candidate current = candidates.top();
+        if ( nearest.size() >= beam && nearest.top() < current ) break;
+        candidates.pop();
+
+        const int *point_links = get_links( current.point, level );
+        for ( int k = 1; k <= point_links[0]; ++k ) {
+            int neighbor = point_links[k];
+            if ( !visits.visit( neighbor ) ) continue;
+
+            Candidate next = { norm( query, points[neighbor] ), neighbor };
+            if ( nearest.size() < beam || next < nearest.top() ) {
+                candidates.push( next );
+                nearest.push( next );
+                if ( nearest.size() > beam ) nearest.pop();
+            }
+        }
+    }
+
+    found.resize( nearest.size() );
+    for ( size_t k = found.size(); k > 0; --k ) {
+        found[k - 1] = nearest.top();
+        nearest.pop();
+    }
+}
+
+void HNSWGraph::select_neighbors( vector<Candidate> &candidates,
+                                  const size_t &count ) const {
+    std::sort( candidates.begin(), candidates.end() );
+
+    // Prefer candidates which are nearer to the point than to any neighbour
+    // selected so far, so that the links point in diverse directions. The
+    // remaining places are filled with the nearest of the others.
+    vector<Candidate> selected;
+    vector<Candidate> skipped;
+    for ( size_t c = 0; c < candidates.size(); ++c ) {
+        if ( selected.size() >= count ) break;
+        const Point *candidate = points[candidates[c].point];
+        const Norm &norm = candidate->noirSpace->norm;
+        bool diverse = true;
+        for ( size_t s = 0; s < selected.size() && diverse; ++s ) {
+            if ( norm( candidate, points[selected[s].point] ) < 
+                                                        candidates[c].dist ) {
+                diverse = false;
+            }
+        }
+        if ( diverse ) {
+            selected.push_back( candidates[c] );
+        } else {
+            skipped.push_back( candidates[c] );
+        }
+    }
+    for ( size_t s = 0; s < skipped.size() && selected.size() < count; ++s ) {
+        selected.push_back( skipped[s] );
+    }
+
+    candidates.swap( selected );
+}
+
+void HNSWGraph::connect( const int &point, const Candidate &neighbor,
+                         const int &level ) {
+    int *point_links = get_links( point, level );
+    int num_links = point_links[0];
+    if ( num_links < capacity( level ) ) {
+        point_links[num_links + 1] = neighbor.point;
+        point_links[0] = num_links + 1;
+        return;
+    }
+
+    // The point has no room left, so the farthest of its old links and the
+    // new neighbour is dropped
+    const Point *from = points[point];
+    const Norm &norm = from->noirSpace->norm;
+    Candidate farthest = neighbor;
+    int farthest_link = 0;
+    for ( int k = 1; k <= num_links; ++k ) {
+        Candidate old = { norm( from, points[point_links[k]] ), 
+                          point_links[k] };
+        if ( farthest < old ) {
+            farthest = old;
+            farthest_link = k;
+        }
+    }
+    if ( farthest_link > 0 ) point_links[farthest_link] = neighbor.point;
+}
+
+int HNSWGraph::nearest( const Point *query, const int &exclude, 
+                        const int &ef, double &dist ) const {
+    dist = std::numeric_limits<double>::max();
+    if ( entry < 0 ) return -1;
+
+    const Norm &norm = query->noirSpace->norm;
+    Candidate nearest = { norm( query, points[entry] ), entry };
+    for ( int l = topLevel; l > 0; --l ) {
+        descend( query, nearest, l );
+    }
+
+    // One place of the beam may be taken by the excluded point
+    vector<Candidate> found( 1, nearest );
+    search_layer( query, found, std::max( ef, 1 ) + 1, 0 );
+    for ( size_t k = 0; k < found.size(); ++k ) {
+        if ( found[k].point != exclude ) {
+            dist = found[k].dist;
+            return found[k].point;
+        }
+    }
+    return -1;
+}
+
+}  // namespace noir
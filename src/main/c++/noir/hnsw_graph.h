@@ -0,0 +1,134 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef NOIR_HNSW_GRAPH_H
+#define NOIR_HNSW_GRAPH_H
+
+#include <cstddef>
+#include <vector>
+
+#include "noir/noir_space.h"
+#include "noir/point.h"
+#include "util/thread_pool.h"
+
+namespace noir {
+
+/*
+ * A hierarchical navigable small world graph for approximate nearest
+ * neighbour queries in a Noir space.
+ *
+ * On the bottom layer every point is linked to some of its near neighbours.
+ * Each layer above holds a thinning subset of the points of the layer below,
+ * again linked to near neighbours. A query descends greedily from the top
+ * layer and then searches the bottom layer with a beam of candidates, which
+ * visits only a small part of the points. Unlike a tree, the graph does not
+ * rely on the triangle inequality, so points with missing coordinates need
+ * no special treatment.
+ *
+ * The layer of a point is derived from its position and the points are
+ * inserted in order, in batches which grow with the graph. The points of a
+ * batch search the graph as it was before the batch, possibly in parallel,
+ * and are then linked in order, so the same points always give the same
+ * graph, whatever the number of threads.
+ */
+class HNSWGraph {
+ public:
+    /*
+     * Builds a graph over the specified points, searching the neighbours
+     * of the points of a batch with the specified thread pool, if any.
+     * Every point is linked to at most max_neighbors others on the upper
+     * layers, and to twice as many on the bottom layer. Each insertion
+     * searches a beam of ef_construction candidates. The graph refers to
+     * the points by their position in the vector, which must outlive the
+     * graph.
+     */
+    explicit HNSWGraph( const std::vector<const Point*> &points,
+                        util::ThreadPool *thread_pool = 0,
+                        const int &max_neighbors = 8,
+                        const int &ef_construction = 32 );
+
+    virtual ~HNSWGraph() {}
+
+    /*
+     * Finds a point near the specified query point, skipping the point at
+     * position exclude, by searching a beam of ef candidates on the bottom
+     * layer. Returns the position of the point found, or -1 if there is
+     * none, and stores its distance in dist.
+     */
+    int nearest( const Point *query, const int &exclude, const int &ef,
+                 double &dist ) const;
+
+ private:
+    struct Candidate {
+        double dist;
+        int point;
+
+        bool operator<( const Candidate &that ) const {
+            return dist < that.dist || 
+                   ( dist == that.dist && point < that.point );
+        }
+
+        bool operator>( const Candidate &that ) const {
+            return that < *this;
+        }
+    };
+
+    // A point to be inserted, and the neighbours it is to be linked to on
+    // each of its layers, from the bottom layer up
+    struct Insertion {
+        int point;
+        std::vector<std::vector<Candidate> > neighbors;
+    };
+
+    const std::vector<const Point*> &points;
+    int maxNeighbors;
+    int efConstruction;
+    int entry;
+    int topLevel;
+    std::vector<int> levels;
+
+    // The links of a point on a layer are a count followed by room for as
+    // many neighbours as the layer allows. The bottom layer is kept in
+    // links, the upper layers of a point in upperLinks from upperOffset on.
+    std::vector<int> links;
+    std::vector<int> upperOffset;
+    std::vector<int> upperLinks;
+
+    int capacity( const int &level ) const {
+        return level == 0 ? 2*maxNeighbors : maxNeighbors;
+    }
+
+    int* get_links( const int &point, const int &level );
+    const int* get_links( const int &point, const int &level ) const;
+
+    void search( Insertion &insertion ) const;
+    void link( const Insertion &insertion );
+    void descend( const Point *query, Candidate &nearest, 
+                  const int &level ) const;
+    void search_layer( const Point *query, std::vector<Candidate> &found,
+                       const int &ef, const int &level ) const;
+    void select_neighbors( std::vector<Candidate> &candidates, 
+                           const size_t &count ) const;
+    void connect( const int &point, const Candidate &neighbor, 
+                  const int &level );
+
+    HNSWGraph(const HNSWGraph&) = delete;
+    HNSWGraph& operator=(const HNSWGraph&) = delete;
+};
+
+}   // end namespace noir
+
+#endif   // NOIR_HNSW_GRAPH_H
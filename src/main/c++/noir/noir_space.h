@@ -17,11 +17,14 @@
 #ifndef NOIR_NOIR_SPACE_H
 #define NOIR_NOIR_SPACE_H
 
+#include <cstddef>
+
 #include "noir/norm.h"
 
 namespace noir {
 
 class Point;
+class PointColumns;
 
 /*
  * A Noir Space is Banach space formed by the Cartesian product of Nominal,
@@ -67,6 +70,14 @@ class ClosedSpace {
      */
     virtual bool in_closure( const Point *point ) const = 0;
 
+    /*
+     * Determines, for each of the points [begin,end) of the specified
+     * columns, whether or not it is contained within the closure of this
+     * Noir space. The answer for point begin+k is stored in inside[k].
+     */
+    virtual void in_closure( const PointColumns &points, const size_t &begin,
+                             const size_t &end, char *inside ) const = 0;
+
     virtual ~ClosedSpace() {}
 };
 
@@ -20,9 +20,121 @@
 #include <cstdlib>
 
 #include "noir/point.h"
+#include "noir/point_columns.h"
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 namespace noir {
 
+namespace {
+
+/*
+ * Evaluates |sin(pi*(x - y))| = |sin(pi*x)cos(pi*y) - cos(pi*x)sin(pi*y)|.
+ * Both products are rounded before they are subtracted, so swapping x and y
+ * only changes the sign of the difference and identical points are at
+ * distance 0. The file is built without contraction into fused
+ * multiply-adds, which would break this, and so that the scalar and vector
+ * forms of the norm stay identical.
+ */
+inline double abs_sin_difference( const double &x_sine, 
+                                  const double &x_cosine,
+                                  const double &y_sine, 
+                                  const double &y_cosine ) {
+    return fabs( x_sine*y_cosine - x_cosine*y_sine );
+}
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+
+// A thin layer over the vector instructions used by the batched norm.
+// Masked adds leave a lane unchanged where the point's coordinate is
+// missing, exactly as the scalar code skips it.
+
+#if defined(__AVX512F__)
+
+const size_t LANES = 8;
+typedef __m512d Lanes;
+
+inline Lanes load( const double *p ) { return _mm512_loadu_pd( p ); }
+inline void store( double *p, const Lanes &a ) { _mm512_storeu_pd( p, a ); }
+inline Lanes broadcast( const double &a ) { return _mm512_set1_pd( a ); }
+inline Lanes add( const Lanes &a, const Lanes &b ) { 
+    return _mm512_add_pd( a, b ); 
+}
+inline Lanes sub( const Lanes &a, const Lanes &b ) { 
+    return _mm512_sub_pd( a, b ); 
+}
+inline Lanes mul( const Lanes &a, const Lanes &b ) { 
+    return _mm512_mul_pd( a, b ); 
+}
+inline Lanes abs_lanes( const Lanes &a ) { return _mm512_abs_pd( a ); }
+
+// a*b - c, with the product rounded as in the scalar code
+inline Lanes mul_sub( const Lanes &a, const Lanes &b, const Lanes &c ) {
+    return sub( mul( a, b ), c );
+}
+
+// sum + term in the lanes where y is not NaN
+inline Lanes add_if_present( const Lanes &sum, const Lanes &y, 
+                             const Lanes &term ) {
+    __mmask8 present = _mm512_cmp_pd_mask( y, y, _CMP_ORD_Q );
+    return _mm512_mask_add_pd( sum, present, sum, term );
+}
+
+// sum + term in the lanes where y is not -1
+inline Lanes add_if_known( const Lanes &sum, const Lanes &y, 
+                           const Lanes &term ) {
+    __mmask8 known = _mm512_cmp_pd_mask( y, broadcast(-1.0), _CMP_NEQ_UQ );
+    return _mm512_mask_add_pd( sum, known, sum, term );
+}
+
+#else
+
+const size_t LANES = 4;
+typedef __m256d Lanes;
+
+inline Lanes load( const double *p ) { return _mm256_loadu_pd( p ); }
+inline void store( double *p, const Lanes &a ) { _mm256_storeu_pd( p, a ); }
+inline Lanes broadcast( const double &a ) { return _mm256_set1_pd( a ); }
+inline Lanes add( const Lanes &a, const Lanes &b ) { 
+    return _mm256_add_pd( a, b ); 
+}
+inline Lanes sub( const Lanes &a, const Lanes &b ) { 
+    return _mm256_sub_pd( a, b ); 
+}
+inline Lanes mul( const Lanes &a, const Lanes &b ) { 
+    return _mm256_mul_pd( a, b ); 
+}
+inline Lanes abs_lanes( const Lanes &a ) { 
+    return _mm256_andnot_pd( broadcast(-0.0), a ); 
+}
+
+// a*b - c, with the product rounded as in the scalar code
+inline Lanes mul_sub( const Lanes &a, const Lanes &b, const Lanes &c ) {
+    return sub( mul( a, b ), c );
+}
+
+// sum + term in the lanes where y is not NaN
+inline Lanes add_if_present( const Lanes &sum, const Lanes &y, 
+                             const Lanes &term ) {
+    Lanes present = _mm256_cmp_pd( y, y, _CMP_ORD_Q );
+    return add( sum, _mm256_blendv_pd( broadcast(0.0), term, present ) );
+}
+
+// sum + term in the lanes where y is not -1
+inline Lanes add_if_known( const Lanes &sum, const Lanes &y, 
+                           const Lanes &term ) {
+    Lanes known = _mm256_cmp_pd( y, broadcast(-1.0), _CMP_NEQ_UQ );
+    return add( sum, _mm256_blendv_pd( broadcast(0.0), term, known ) );
+}
+
+#endif
+
+#endif
+
+}  // namespace
+
 double Norm::operator()(const Point* x, const Point* y) const {
     double dist = 0.0;
 
@@ -35,12 +147,17 @@ double Norm::operator()(const Point* x, const Point* y) const {
         dist += fabs(x_reals[r] - y_reals[r]);
     }
 
+    // |sin(pi*(x - y))| from the precomputed sines and cosines
     double const *x_intervals = x->get_interval_coordinates();
     double const *y_intervals = y->get_interval_coordinates();
+    double const *x_sines = x->get_interval_sines();
+    double const *y_sines = y->get_interval_sines();
+    double const *x_cosines = x->get_interval_cosines();
+    double const *y_cosines = y->get_interval_cosines();
     for ( int i = 0; i < noirSpace->interval; ++i ){
         if ( isnan(x_intervals[i]) || isnan(y_intervals[i]) ) continue;
-        double sin_arg = sin(M_PI*(x_intervals[i] - y_intervals[i]));
-        dist += fabs(sin_arg);
+        dist += abs_sin_difference( x_sines[i], x_cosines[i],
+                                    y_sines[i], y_cosines[i] );
     }
 
     double const *x_ordinals = x->get_ordinal_coordinates();
@@ -60,6 +177,98 @@ double Norm::operator()(const Point* x, const Point* y) const {
     return dist;
 }
 
+void Norm::operator()(const Point* x, const PointColumns &y, 
+                      const size_t &begin, const size_t &end,
+                      double *dist) const {
+    const NoirSpace *const noirSpace = x->noirSpace;
+    const size_t num_points = end - begin;
+
+    for ( size_t k = 0; k < num_points; ++k ){
+        dist[k] = 0.0;
+    }
+
+    // The dimensions are summed in the same order as for a single pair of
+    // points, so both forms give identical distances. Whole groups of 
+    // LANES points are handled by the vector kernels, if available.
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+    const size_t num_vector = (num_points/LANES)*LANES;
+#else
+    const size_t num_vector = 0;
+#endif
+
+    double const *x_reals = x->get_real_coordinates();
+    for ( int r = 0; r < noirSpace->real; ++r ){
+        if ( isnan(x_reals[r]) ) continue; 
+        double const *y_reals = y.get_real_column(r) + begin;
+#if defined(__AVX512F__) || defined(__AVX2__)
+        Lanes xr = broadcast( x_reals[r] );
+        for ( size_t k = 0; k < num_vector; k += LANES ){
+            Lanes yr = load( y_reals + k );
+            Lanes term = abs_lanes( sub( xr, yr ) );
+            store( dist + k, add_if_present( load( dist + k ), yr, term ) );
+        }
+#endif
+        for ( size_t k = num_vector; k < num_points; ++k ){
+            if ( isnan(y_reals[k]) ) continue; 
+            dist[k] += fabs(x_reals[r] - y_reals[k]);
+        }
+    }
+
+    double const *x_intervals = x->get_interval_coordinates();
+    double const *x_sines = x->get_interval_sines();
+    double const *x_cosines = x->get_interval_cosines();
+    for ( int i = 0; i < noirSpace->interval; ++i ){
+        if ( isnan(x_intervals[i]) ) continue;
+        double const *y_intervals = y.get_interval_column(i) + begin;
+        double const *y_sines = y.get_interval_sine_column(i) + begin;
+        double const *y_cosines = y.get_interval_cosine_column(i) + begin;
+#if defined(__AVX512F__) || defined(__AVX2__)
+        Lanes xs = broadcast( x_sines[i] );
+        Lanes xc = broadcast( x_cosines[i] );
+        for ( size_t k = 0; k < num_vector; k += LANES ){
+            Lanes yi = load( y_intervals + k );
+            Lanes term = abs_lanes( mul_sub( xs, load( y_cosines + k ),
+                                             mul( xc, load( y_sines + k ) ) ) );
+            store( dist + k, add_if_present( load( dist + k ), yi, term ) );
+        }
+#endif
+        for ( size_t k = num_vector; k < num_points; ++k ){
+            if ( isnan(y_intervals[k]) ) continue;
+            dist[k] += abs_sin_difference( x_sines[i], x_cosines[i],
+                                           y_sines[k], y_cosines[k] );
+        }
+    }
+
+    double const *x_ordinals = x->get_ordinal_coordinates();
+    for ( int o = 0; o < noirSpace->ordinal; ++o ){
+        if ( x_ordinals[o] == -1 ) continue;
+        double const *y_ordinals = y.get_ordinal_column(o) + begin;
+#if defined(__AVX512F__) || defined(__AVX2__)
+        Lanes xo = broadcast( x_ordinals[o] );
+        for ( size_t k = 0; k < num_vector; k += LANES ){
+            Lanes yo = load( y_ordinals + k );
+            Lanes term = abs_lanes( sub( xo, yo ) );
+            store( dist + k, add_if_known( load( dist + k ), yo, term ) );
+        }
+#endif
+        for ( size_t k = num_vector; k < num_points; ++k ){
+            if ( y_ordinals[k] == -1 ) continue;
+            dist[k] += fabs(x_ordinals[o] - y_ordinals[k]);
+        }
+    }
+
+    int const *x_nominals = x->get_nominal_coordinates();
+    for ( int n = 0; n < noirSpace->nominal; ++n ){
+        if ( x_nominals[n] == -1 ) continue;
+        int const *y_nominals = y.get_nominal_column(n) + begin;
+        for ( size_t k = 0; k < num_points; ++k ){
+            if ( y_nominals[k] == -1 ) continue;
+            dist[k] += ( x_nominals[n] == y_nominals[k] ? 0.0 : 1.0 );
+        }
+    }
+}
+
 double Norm::operator()(const Point* x) const {
     double dist = 0.0;
 
@@ -72,9 +281,10 @@ double Norm::operator()(const Point* x) const {
     }
 
     double const *x_intervals = x->get_interval_coordinates();
+    double const *x_sines = x->get_interval_sines();
     for ( int i = 0; i < noirSpace->interval; ++i ){
         if ( isnan(x_intervals[i]) ) continue;
-        dist += fabs( sin(M_PI*x_intervals[i]) );
+        dist += fabs( x_sines[i] );
     }
 
     double const *x_ordinals = x->get_ordinal_coordinates();
@@ -17,9 +17,12 @@
 #ifndef NOIR_NORM_H
 #define NOIR_NORM_H
 
+#include <cstddef>
+
 namespace noir {
 
 class Point;
+class PointColumns;
 
 /*
  * An L1 norm for a Noir Space.
@@ -34,6 +37,14 @@ struct Norm {
      * Calculate distance between the specified points using the L1 norm.
      */
     double operator()(const Point* x, const Point* y) const;
+
+    /*
+     * Calculate the distances between the specified point and each of the
+     * points [begin,end) of the specified columns using the L1 norm. The
+     * distance to point begin+k is stored in dist[k].
+     */
+    void operator()(const Point* x, const PointColumns &y, const size_t &begin,
+                    const size_t &end, double *dist) const;
 };
 
 }   // end namespace noir
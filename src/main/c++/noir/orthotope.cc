@@ -18,134 +18,363 @@
 #include "noir/orthotope.h"
 
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <limits>
-#include <set>
+
+#include "noir/point_columns.h"
+#include "util/invalid_input_error.h"
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 namespace noir {
 
-using std::set;
+namespace {
+
+// Vector kernels for the batched in_closure. Each returns a bit mask with
+// bit j set if the (j+1)-th of the values starting at column lies outside
+// [lower,upper]. The ordered compares are false for NaN, so missing values
+// never put a point outside.
+
+#if defined(__AVX512F__)
+
+const size_t LANES = 8;
+
+inline unsigned lanes_outside( const double *column, const double &lower,
+                               const double &upper ) {
+    __m512d value = _mm512_loadu_pd( column );
+    return _mm512_cmp_pd_mask( value, _mm512_set1_pd(lower), _CMP_LT_OQ ) |
+           _mm512_cmp_pd_mask( value, _mm512_set1_pd(upper), _CMP_GT_OQ );
+}
+
+// For a periodic interval that wraps around, i.e. upper < lower
+inline unsigned lanes_outside_wrapped( const double *column, 
+                                       const double &lower,
+                                       const double &upper ) {
+    __m512d value = _mm512_loadu_pd( column );
+    return _mm512_cmp_pd_mask( value, _mm512_set1_pd(lower), _CMP_LT_OQ ) &
+           _mm512_cmp_pd_mask( value, _mm512_set1_pd(upper), _CMP_GT_OQ );
+}
+
+// For ordinals, whose missing values are -1
+inline unsigned lanes_outside_ordinal( const double *column, 
+                                       const double &lower,
+                                       const double &upper ) {
+    __m512d value = _mm512_loadu_pd( column );
+    return _mm512_cmp_pd_mask( value, _mm512_set1_pd(-1.0), _CMP_NEQ_OQ ) &
+         ( _mm512_cmp_pd_mask( value, _mm512_set1_pd(lower), _CMP_LT_OQ ) |
+           _mm512_cmp_pd_mask( value, _mm512_set1_pd(upper), _CMP_GT_OQ ) );
+}
+
+#elif defined(__AVX2__)
+
+const size_t LANES = 4;
+
+inline unsigned lanes_outside( const double *column, const double &lower,
+                               const double &upper ) {
+    __m256d value = _mm256_loadu_pd( column );
+    __m256d below = _mm256_cmp_pd( value, _mm256_set1_pd(lower), _CMP_LT_OQ );
+    __m256d above = _mm256_cmp_pd( value, _mm256_set1_pd(upper), _CMP_GT_OQ );
+    return _mm256_movemask_pd( _mm256_or_pd( below, above ) );
+}
+
+// For a periodic interval that wraps around, i.e. upper < lower
+inline unsigned lanes_outside_wrapped( const double *column, 
+                                       const double &lower,
+                                       const double &upper ) {
+    __m256d value = _mm256_loadu_pd( column );
+    __m256d below = _mm256_cmp_pd( value, _mm256_set1_pd(lower), _CMP_LT_OQ );
+    __m256d above = _mm256_cmp_pd( value, _mm256_set1_pd(upper), _CMP_GT_OQ );
+    return _mm256_movemask_pd( _mm256_and_pd( below, above ) );
+}
+
+// For ordinals, whose missing values are -1
+inline unsigned lanes_outside_ordinal( const double *column, 
+                                       const double &lower,
+                                       const double &upper ) {
+    __m256d value = _mm256_loadu_pd( column );
+    __m256d known = _mm256_cmp_pd( value, _mm256_set1_pd(-1.0), _CMP_NEQ_OQ );
+    __m256d below = _mm256_cmp_pd( value, _mm256_set1_pd(lower), _CMP_LT_OQ );
+    __m256d above = _mm256_cmp_pd( value, _mm256_set1_pd(upper), _CMP_GT_OQ );
+    return _mm256_movemask_pd( 
+                    _mm256_and_pd( known, _mm256_or_pd( below, above ) ) );
+}
+
+#endif
 
-Orthotope::Orthotope( const NoirSpace *noir_space ):
+}  // namespace
+
+Orthotope::Orthotope( const NoirSpace *noir_space, util::Arena *arena ):
                             noirSpace(noir_space),
-                            ordinal_boundaries(0),
-                            interval_boundaries(0),
-                            real_boundaries(0),
-                            allowed_nominals(0) {
+                            ordinal_lower(0), ordinal_upper(0),
+                            interval_lower(0), interval_upper(0),
+                            real_lower(0), real_upper(0),
+                            nominal_masks(0), nominal_words(1),
+                            arena(arena), owned_storage(0), owned_masks(0) {
 
-    allowed_nominals = new set<int>[noirSpace->nominal];
-    for ( int n = 0; n < noirSpace->nominal; ++n ) {
-        allowed_nominals[n].clear();
+    // All lower and upper bounds, followed by the nominal masks, share a
+    // single block of memory.
+    int num_bounded = noirSpace->ordinal + noirSpace->interval + 
+                      noirSpace->real;
+    size_t size = 2*num_bounded*sizeof(double) + 
+                  noirSpace->nominal*nominal_words*sizeof(uint64_t);
+
+    char *storage = 0;
+    if ( arena != 0 ) {
+        storage = static_cast<char*>( arena->allocate( size, 
+                                                       sizeof(double) ) );
+    } else {
+        storage = owned_storage = new char[size];
     }
 
-    ordinal_boundaries = new double*[noirSpace->ordinal];
+    double *bounds = reinterpret_cast<double*>( storage );
+    ordinal_lower  = bounds;
+    ordinal_upper  = ordinal_lower + noirSpace->ordinal;
+    interval_lower = ordinal_upper + noirSpace->ordinal;
+    interval_upper = interval_lower + noirSpace->interval;
+    real_lower     = interval_upper + noirSpace->interval;
+    real_upper     = real_lower + noirSpace->real;
+
     for ( int o = 0; o < noirSpace->ordinal; ++o ) {
-        ordinal_boundaries[o] = new double[2];
-        ordinal_boundaries[o][0] = -std::numeric_limits<double>::max();
-        ordinal_boundaries[o][1] =  std::numeric_limits<double>::max();
+        ordinal_lower[o] = -std::numeric_limits<double>::max();
+        ordinal_upper[o] =  std::numeric_limits<double>::max();
     }
-
-    interval_boundaries = new double*[noirSpace->interval];
     for ( int i = 0; i < noirSpace->interval; ++i ) {
-        interval_boundaries[i] = new double[2];
-        interval_boundaries[i][0] = -std::numeric_limits<double>::max();
-        interval_boundaries[i][1] =  std::numeric_limits<double>::max();
+        interval_lower[i] = -std::numeric_limits<double>::max();
+        interval_upper[i] =  std::numeric_limits<double>::max();
     }
-
-
-    real_boundaries = new double*[noirSpace->real];
     for ( int r = 0; r < noirSpace->real; ++r ) {
-        real_boundaries[r] = new double[2];
-        real_boundaries[r][0] = -std::numeric_limits<double>::max();
-        real_boundaries[r][1] =  std::numeric_limits<double>::max();
+        real_lower[r] = -std::numeric_limits<double>::max();
+        real_upper[r] =  std::numeric_limits<double>::max();
     }
+
+    nominal_masks = reinterpret_cast<uint64_t*>( bounds + 2*num_bounded );
+    memset( nominal_masks, 0, 
+            noirSpace->nominal*nominal_words*sizeof(uint64_t) );
+}
+
+Orthotope::Orthotope( const NoirSpace *noir_space, const char *record ):
+                            noirSpace(noir_space),
+                            ordinal_lower(0), ordinal_upper(0),
+                            interval_lower(0), interval_upper(0),
+                            real_lower(0), real_upper(0),
+                            nominal_masks(0), nominal_words(1),
+                            arena(0), owned_storage(0), owned_masks(0) {
+
+    // The record holds the number of words of each nominal mask, followed
+    // by the bounds and the masks as they are kept by any orthotope. Its
+    // memory is never written through the pointers set here.
+    nominal_words = static_cast<int>( 
+                            *reinterpret_cast<const int64_t*>( record ) );
+
+    double *bounds = reinterpret_cast<double*>( 
+                            const_cast<char*>( record ) + sizeof(int64_t) );
+    ordinal_lower  = bounds;
+    ordinal_upper  = ordinal_lower + noirSpace->ordinal;
+    interval_lower = ordinal_upper + noirSpace->ordinal;
+    interval_upper = interval_lower + noirSpace->interval;
+    real_lower     = interval_upper + noirSpace->interval;
+    real_upper     = real_lower + noirSpace->real;
+
+    nominal_masks = reinterpret_cast<uint64_t*>( real_upper + 
+                                                 noirSpace->real );
 }
 
 Orthotope::~Orthotope() {
-    delete[] allowed_nominals;
+    delete[] owned_masks;
+    delete[] owned_storage;
+}
+
+/*
+ * Widens the nominal masks to the specified number of words per coordinate.
+ */
+void Orthotope::grow_nominal_masks( const int &num_words ) {
+    size_t size = noirSpace->nominal*num_words;
+
+    uint64_t *masks = 0;
+    if ( arena != 0 ) {
+        masks = static_cast<uint64_t*>( arena->allocate( 
+                                        size*sizeof(uint64_t), 
+                                        sizeof(uint64_t) ) );
+    } else {
+        masks = new uint64_t[size];
+    }
 
-    for ( int o = 0; o < noirSpace->ordinal; o++ ) {
-        delete[] ordinal_boundaries[o];
+    memset( masks, 0, size*sizeof(uint64_t) );
+    for ( int n = 0; n < noirSpace->nominal; ++n ) {
+        for ( int w = 0; w < nominal_words; ++w ) {
+            masks[n*num_words + w] = nominal_masks[n*nominal_words + w];
+        }
+    }
+
+    delete[] owned_masks;
+    if ( arena == 0 ) owned_masks = masks;
+
+    nominal_masks = masks;
+    nominal_words = num_words;
+}
+
+void Orthotope::write( util::BinaryWriter &out ) const {
+    int num_bounded = noirSpace->ordinal + noirSpace->interval + 
+                      noirSpace->real;
+
+    // The bounds are kept in one block, starting with the ordinal ones
+    out.write_int( nominal_words );
+    out.write( ordinal_lower, 2*num_bounded*sizeof(double) );
+    out.write( nominal_masks, 
+               noirSpace->nominal*nominal_words*sizeof(uint64_t) );
+}
+
+void Orthotope::read( util::BinaryReader &in ) {
+    int num_bounded = noirSpace->ordinal + noirSpace->interval + 
+                      noirSpace->real;
+
+    int64_t num_words = in.read_int();
+    if ( num_words < 1 || num_words > std::numeric_limits<int>::max()/64 ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                        "Invalid number of nominal words of an orthotope." );
+    }
+    if ( num_words > nominal_words ) {
+        grow_nominal_masks( static_cast<int>(num_words) );
+    }
+
+    in.read( ordinal_lower, 2*num_bounded*sizeof(double) );
+    memset( nominal_masks, 0, 
+            noirSpace->nominal*nominal_words*sizeof(uint64_t) );
+    for ( int n = 0; n < noirSpace->nominal; ++n ) {
+        in.read( nominal_masks + n*nominal_words, 
+                 num_words*sizeof(uint64_t) );
     }
-    delete[] ordinal_boundaries;
+}
+
+int Orthotope::get_num_nominals( const int &coordinate ) const {
+    int num_nominals = 0;
+    for ( int w = 0; w < nominal_words; ++w ) {
+        uint64_t mask = nominal_masks[coordinate*nominal_words + w];
+        num_nominals += __builtin_popcountll( mask );
+    }
+    return num_nominals;
+}
+
+void Orthotope::in_closure( const PointColumns &points, const size_t &begin,
+                            const size_t &end, char *inside ) const {
+#if defined(__AVX512F__) || defined(__AVX2__)
+    // Whole groups of LANES points are tested with vector compares, one
+    // coordinate column after the other; the rest is tested one by one.
+    const size_t vector_end = begin + ((end - begin)/LANES)*LANES;
 
-    for ( int i = 0; i < noirSpace->interval; i++ ) {
-        delete[] interval_boundaries[i];
+    for ( size_t k = begin; k < vector_end; k += LANES ) {
+        unsigned outside = 0;
+
+        for ( int r = 0; r < noirSpace->real; ++r ) {
+            outside |= lanes_outside( points.get_real_column(r) + k,
+                                      real_lower[r], real_upper[r] );
+        }
+
+        for ( int i = 0; i < noirSpace->interval; ++i ) {
+            const double *intervals = points.get_interval_column(i) + k;
+            if ( interval_upper[i] < interval_lower[i] ) {
+                outside |= lanes_outside_wrapped( intervals,
+                                            interval_lower[i], 
+                                            interval_upper[i] );
+            } else {
+                outside |= lanes_outside( intervals,
+                                          interval_lower[i], 
+                                          interval_upper[i] );
+            }
+        }
+
+        for ( int o = 0; o < noirSpace->ordinal; ++o ) {
+            const double *ordinals = points.get_ordinal_column(o) + k;
+            outside |= lanes_outside_ordinal( ordinals, ordinal_lower[o], 
+                                              ordinal_upper[o] );
+        }
+
+        for ( size_t j = 0; j < LANES; ++j ) {
+            inside[k - begin + j] = ( (outside >> j) & 1 ) ? 0 : 1;
+        }
     }
-    delete[] interval_boundaries;
 
-    for ( int r = 0; r < noirSpace->real; r++ ) {
-        delete[] real_boundaries[r];
+    // Check the nominal cooordinates
+
+    for ( int n = 0; n < noirSpace->nominal; ++n ) {
+        const int* nominals = points.get_nominal_column(n);
+        for ( size_t k = begin; k < vector_end; ++k ) {
+            if ( !inside[k - begin] || nominals[k] == -1 ) continue;
+            if ( !allows_nominal( n, nominals[k] ) ) inside[k - begin] = 0;
+        }
     }
-    delete[] real_boundaries;
+
+    in_closure_scalar( points, vector_end, end, inside + (vector_end - begin) );
+#else
+    in_closure_scalar( points, begin, end, inside );
+#endif
 }
 
-bool Orthotope::in_closure( const Point *point ) const {
+void Orthotope::in_closure_scalar( const PointColumns &points, 
+                                   const size_t &begin, const size_t &end, 
+                                   char *inside ) const {
+    const size_t num_points = end - begin;
 
-    bool in_closure = true;
+    for ( size_t k = 0; k < num_points; ++k ) {
+        inside[k] = 1;
+    }
 
     // Check the real cooordinates
 
-    const double* reals = point->get_real_coordinates();
     for ( int r = 0; r < noirSpace->real; ++r ) {
-        if ( isnan(reals[r]) ) continue;
-        if ( reals[r] < real_boundaries[r][0] ||
-             reals[r] > real_boundaries[r][1]   ) {
-            in_closure = false;
-            break;
+        const double* reals = points.get_real_column(r) + begin;
+        double lower = real_lower[r];
+        double upper = real_upper[r];
+        for ( size_t k = 0; k < num_points; ++k ) {
+            double value = reals[k];
+            if ( value < lower || value > upper ) inside[k] = 0;
         }
     }
 
-    if ( !in_closure ) return false;
-
     // Check the interval cooordinates
 
-    const double* intervals = point->get_interval_coordinates();
     for ( int i = 0; i < noirSpace->interval; ++i ) {
-        if ( isnan(intervals[i]) ) continue;
-        double lower = interval_boundaries[i][0];
-        double upper = interval_boundaries[i][1];
-        double value = intervals[i];
+        const double* intervals = points.get_interval_column(i) + begin;
+        double lower = interval_lower[i];
+        double upper = interval_upper[i];
         if ( upper < lower ) {
-            if ( !(lower <= value || value <= upper ) ) {
-                in_closure = false;
-                break;
+            for ( size_t k = 0; k < num_points; ++k ) {
+                double value = intervals[k];
+                if ( value < lower && value > upper ) inside[k] = 0;
             }
         } else {
-            if ( !(lower <= value && value <= upper ) ) {
-                in_closure = false;
-                break;
+            for ( size_t k = 0; k < num_points; ++k ) {
+                double value = intervals[k];
+                if ( value < lower || value > upper ) inside[k] = 0;
             }
         }
     }
 
-    if ( !in_closure ) return false;
-
     // Check the ordinal cooordinates
 
-    const double* ordinals = point->get_ordinal_coordinates();
     for ( int o = 0; o < noirSpace->ordinal; ++o ) {
-        if ( ordinals[o] == -1) continue;
-        if ( ordinals[o] < ordinal_boundaries[o][0] ||
-             ordinals[o] > ordinal_boundaries[o][1]   ) {
-            in_closure = false;
-            break;
+        const double* ordinals = points.get_ordinal_column(o) + begin;
+        double lower = ordinal_lower[o];
+        double upper = ordinal_upper[o];
+        for ( size_t k = 0; k < num_points; ++k ) {
+            double value = ordinals[k];
+            if ( value == -1 ) continue;
+            if ( value < lower || value > upper ) inside[k] = 0;
         }
     }
 
-    if ( !in_closure ) return false;
-
     // Check the nominal cooordinates
-    const int* nominals = point->get_nominal_coordinates();
+
     for ( int n = 0; n < noirSpace->nominal; ++n ) {
-        if ( nominals[n] == -1 ) continue;
-        if ( allowed_nominals[n].find(nominals[n]) ==
-                                    allowed_nominals[n].end() ) {
-            in_closure = false;
-            break;
+        const int* nominals = points.get_nominal_column(n) + begin;
+        for ( size_t k = 0; k < num_points; ++k ) {
+            if ( nominals[k] == -1 ) continue;
+            if ( !allows_nominal( n, nominals[k] ) ) inside[k] = 0;
         }
     }
-
-    return in_closure;
 }
 
 }  // namespace noir
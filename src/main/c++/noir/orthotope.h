@@ -18,11 +18,14 @@
 #define NOIR_ORTHOTOPE_H
 
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <limits>
-#include <set>
 
 #include "noir/point.h"
 #include "noir/noir_space.h"
+#include "util/arena.h"
+#include "util/binary_file.h"
 
 namespace noir {
 
@@ -30,14 +33,32 @@ namespace noir {
  * A Orthotope is a Cartesian product of two or more intervals. In Noir space
  * these intervals are very general, consiting of Nominal, Ordinal, periodic
  * and real values.
- * 
+ *
+ * The boundaries of each kind of coordinate are kept in contiguous arrays of
+ * lower and upper bounds, and the allowed values of each nominal coordinate
+ * in a bitmask of a fixed number of 64 bit words.
  */
-class Orthotope : public ClosedSpace {
+class Orthotope final : public ClosedSpace {
  public:
     // The space in which this orthotope lives
     NoirSpace const * const noirSpace;
     
-    explicit Orthotope(const NoirSpace *noirSpace);
+    /*
+     * Creates an unbounded orthotope. If an arena is specified, all of the
+     * orthotope's storage is taken from it, otherwise the orthotope makes a
+     * single allocation of its own.
+     */
+    explicit Orthotope(const NoirSpace *noirSpace, util::Arena *arena = 0);
+
+    /*
+     * Creates a read-only orthotope over a record written by write, without
+     * copying it: the bounds and nominal masks of the orthotope are those of
+     * the record, which is laid out as the storage of any orthotope. The
+     * record must be aligned to eight bytes and stay in place, e.g. in a
+     * file mapped into memory, while the orthotope is used, and the
+     * orthotope must not be changed.
+     */
+    Orthotope(const NoirSpace *noirSpace, const char *record);
 
     virtual ~Orthotope();
 
@@ -45,23 +66,47 @@ class Orthotope : public ClosedSpace {
      * Adds a nominal value to the set of values for the specified coordinate.
      */
     void add_nominal(const int &coordinate, const int &nominal_value) {
-        allowed_nominals[coordinate].insert(nominal_value);
+        if ( nominal_value < 0 ) return;
+        if ( nominal_value >= 64*nominal_words ) {
+            grow_nominal_masks( nominal_value/64 + 1 );
+        }
+        nominal_masks[coordinate*nominal_words + nominal_value/64] |= 
+                            static_cast<uint64_t>(1) << (nominal_value % 64);
     }
 
     /*
-     * Retrieves the set of nominal values for the specified coordinate
+     * Checks whether or not the specified nominal value is allowed for the
+     * specified coordinate.
      */
-    const std::set<int>& get_nominals(const int &coordinate) const {
-        return allowed_nominals[coordinate];
+    bool allows_nominal(const int &coordinate, const int &nominal_value) const{
+        if ( nominal_value < 0 || nominal_value >= 64*nominal_words ) {
+            return false;
+        }
+        return ( nominal_masks[coordinate*nominal_words + nominal_value/64] >> 
+                                                (nominal_value % 64) ) & 1;
     }
 
+    /*
+     * Retrieves a limit on the nominal values: all values allowed for any
+     * coordinate are less than it.
+     */
+    int get_nominal_limit() const {
+        return 64*nominal_words;
+    }
+
+    /*
+     * Retrieves the number of nominal values allowed for the specified
+     * coordinate
+     */
+    int get_num_nominals(const int &coordinate) const;
+
     /*
      * Set lower and upper boundaries for the specified ordinal coordinate.
      */
     void set_ordinal_boundaries(const int &coordinate, double lower, 
                                                                 double upper) {
-        ordinal_boundaries[coordinate][0] = lower;
-        ordinal_boundaries[coordinate][1] = upper;
+        ordinal_lower[coordinate] = lower;
+        ordinal_upper[coordinate] = upper;
     }
 
     /*
@@ -69,8 +114,8 @@ class Orthotope : public ClosedSpace {
      */
     void get_ordinal_boundaries(const int &coordinate, 
                                  double &lower, double &upper) const {
-        lower = ordinal_boundaries[coordinate][0];
-        upper = ordinal_boundaries[coordinate][1];
+        lower = ordinal_lower[coordinate];
+        upper = ordinal_upper[coordinate];
     }
 
     /*
@@ -78,8 +123,8 @@ class Orthotope : public ClosedSpace {
      */
     void set_interval_boundaries(const int &coordinate, 
                                  double lower, double upper) {
-        interval_boundaries[coordinate][0] = lower;
-        interval_boundaries[coordinate][1] = upper;
+        interval_lower[coordinate] = lower;
+        interval_upper[coordinate] = upper;
     }
 
     /*
@@ -87,16 +132,17 @@ class Orthotope : public ClosedSpace {
      */
     void get_interval_boundaries(const int &coordinate, 
                                  double &lower, double &upper) const {
-        lower = interval_boundaries[coordinate][0];
-        upper = interval_boundaries[coordinate][1];
+        lower = interval_lower[coordinate];
+        upper = interval_upper[coordinate];
     }
 
     /*
      * Set lower and upper boundaries for the specified real coordinate.
      */
-    void set_real_boundaries(const int &coordinate, double lower, double upper){
-        real_boundaries[coordinate][0] = lower;
-        real_boundaries[coordinate][1] = upper;
+    void set_real_boundaries(const int &coordinate, 
+                             double lower, double upper) {
+        real_lower[coordinate] = lower;
+        real_upper[coordinate] = upper;
     }
 
     /*
@@ -104,27 +150,129 @@ class Orthotope : public ClosedSpace {
      */
     void get_real_boundaries(const int &coordinate, 
                              double &lower, double &upper) const {
-        lower = real_boundaries[coordinate][0];
-        upper = real_boundaries[coordinate][1];
+        lower = real_lower[coordinate];
+        upper = real_upper[coordinate];
     }
 
     /*
      * Determines whether or the not the specified point is contained within
-     * the closure of this Noir space.
+     * the closure of this Noir space. It is defined inline, so that models
+     * holding orthotopes as such can have it inlined.
      */
     bool in_closure( const Point *point ) const;
 
+    /*
+     * Determines, for each of the points [begin,end) of the specified
+     * columns, whether or not it is contained within the closure of this
+     * Noir space. The answer for point begin+k is stored in inside[k].
+     *
+     * When built for AVX-512 or AVX2 the points are tested several at a
+     * time with vector compares.
+     */
+    void in_closure( const PointColumns &points, const size_t &begin,
+                     const size_t &end, char *inside ) const;
+
+    /*
+     * Writes this orthotope: the number of words of each nominal mask, all
+     * lower and upper bounds, ordinal, interval and real in turn, and then
+     * the nominal masks.
+     */
+    void write( util::BinaryWriter &out ) const;
+
+    /*
+     * Reads an orthotope written by write into this one, which must live in
+     * a space of the same dimensions.
+     */
+    void read( util::BinaryReader &in );
+
+    /*
+     * Retrieves the size in bytes of the record written by write.
+     */
+    size_t get_record_size() const {
+        int num_bounded = noirSpace->ordinal + noirSpace->interval + 
+                          noirSpace->real;
+        return sizeof(int64_t) + 2*num_bounded*sizeof(double) + 
+               noirSpace->nominal*nominal_words*sizeof(uint64_t);
+    }
+
  private:
-    double **ordinal_boundaries;
-    double **interval_boundaries;
-    double **real_boundaries;
+    double *ordinal_lower;
+    double *ordinal_upper;
+    double *interval_lower;
+    double *interval_upper;
+    double *real_lower;
+    double *real_upper;
 
-    std::set<int> *allowed_nominals;
+    uint64_t *nominal_masks;
+    int nominal_words;
+
+    util::Arena *arena;
+    char *owned_storage;
+    uint64_t *owned_masks;
+
+    void grow_nominal_masks( const int &num_words );
+    void in_closure_scalar( const PointColumns &points, const size_t &begin,
+                            const size_t &end, char *inside ) const;
 
     Orthotope(const Orthotope&) = delete;
     Orthotope& operator=(const Orthotope&) = delete;
 };
 
+inline bool Orthotope::in_closure( const Point *point ) const {
+
+    // Missing real and interval coordinates are NaN, which fail every
+    // comparison and so never put a point outside.
+
+    // Check the real cooordinates
+
+    bool outside = false;
+    const double* reals = point->get_real_coordinates();
+    for ( int r = 0; r < noirSpace->real; ++r ) {
+        double value = reals[r];
+        outside |= ( value < real_lower[r] ) | ( value > real_upper[r] );
+    }
+
+    if ( outside ) return false;
+
+    // Check the interval cooordinates
+
+    const double* intervals = point->get_interval_coordinates();
+    for ( int i = 0; i < noirSpace->interval; ++i ) {
+        double lower = interval_lower[i];
+        double upper = interval_upper[i];
+        double value = intervals[i];
+        if ( upper < lower ) {
+            outside |= ( value < lower ) & ( value > upper );
+        } else {
+            outside |= ( value < lower ) | ( value > upper );
+        }
+    }
+
+    if ( outside ) return false;
+
+    // Check the ordinal cooordinates
+
+    const double* ordinals = point->get_ordinal_coordinates();
+    for ( int o = 0; o < noirSpace->ordinal; ++o ) {
+        double value = ordinals[o];
+        outside |= ( value != -1 ) & 
+                   ( ( value < ordinal_lower[o] ) | 
+                     ( value > ordinal_upper[o] ) );
+    }
+
+    if ( outside ) return false;
+
+    // Check the nominal cooordinates
+
+    const int* nominals = point->get_nominal_coordinates();
+    for ( int n = 0; n < noirSpace->nominal; ++n ) {
+        if ( nominals[n] == -1 ) continue;
+        if ( !allows_nominal( n, nominals[n] ) ) return false;
+    }
+
+    return true;
+}
+
 }   // end namespace noir
 
 #endif   // NOIR_ORTHOTOPE_H
@@ -24,12 +24,47 @@ namespace noir {
 
 Point::Point( const NoirSpace *noirSpace) :
               noirSpace(noirSpace),
-              nominals(0), ordinals(0), intervals(0), reals(0) {
+              nominals(0), ordinals(0), intervals(0), intervalSines(0),
+              intervalCosines(0), reals(0), 
+              ownedStorage(0) {
 
-    nominals  = new int[noirSpace->nominal];
-    ordinals  = new double[noirSpace->ordinal];
-    intervals = new double[noirSpace->interval];
-    reals     = new double[noirSpace->real];
+    ownedStorage = new char[storage_size( noirSpace )];
+    init( ownedStorage );
+}
+
+Point::Point( const NoirSpace *noirSpace, void *storage ) :
+              noirSpace(noirSpace),
+              nominals(0), ordinals(0), intervals(0), intervalSines(0),
+              intervalCosines(0), reals(0), 
+              ownedStorage(0) {
+    if ( storage == 0 ) {
+        storage = ownedStorage = new char[storage_size( noirSpace )];
+    }
+    init( storage );
+}
+
+Point::~Point() {
+    delete[] ownedStorage;
+}
+
+size_t Point::storage_size( const NoirSpace *noirSpace ) {
+    size_t num_doubles = noirSpace->real + 3*noirSpace->interval + 
+                         noirSpace->ordinal;
+    return num_doubles*sizeof(double) + noirSpace->nominal*sizeof(int);
+}
+
+/*
+ * Lays out the coordinates in the specified storage: the real, interval and
+ * ordinal coordinates first, so they are aligned, followed by the nominal
+ * coordinates. The sines and cosines follow the interval coordinates.
+ */
+void Point::init( void *storage ) {
+    reals     = static_cast<double*>( storage );
+    intervals = reals + noirSpace->real;
+    intervalSines   = intervals + noirSpace->interval;
+    intervalCosines = intervalSines + noirSpace->interval;
+    ordinals  = intervalCosines + noirSpace->interval;
+    nominals  = reinterpret_cast<int*>( ordinals + noirSpace->ordinal );
 
     for ( int n = 0; n < noirSpace->nominal; ++n ){
         nominals[n] = 0;
@@ -41,6 +76,8 @@ Point::Point( const NoirSpace *noirSpace) :
 
     for ( int i = 0; i < noirSpace->interval; ++i ){
         intervals[i] = 0.0;
+        intervalSines[i] = 0.0;
+        intervalCosines[i] = 1.0;
     }
 
     for ( int r = 0; r < noirSpace->real; ++r ){
@@ -48,11 +85,4 @@ Point::Point( const NoirSpace *noirSpace) :
     }
 }
 
-Point::~Point() {
-    delete[] nominals;
-    delete[] ordinals;
-    delete[] intervals;
-    delete[] reals;
-}
-
 }  // namespace noir
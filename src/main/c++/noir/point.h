@@ -17,6 +17,9 @@
 #ifndef NOIR_POINT_H
 #define NOIR_POINT_H
 
+#include <cmath>
+#include <cstddef>
+
 #include "noir/noir_space.h"
 
 namespace noir {
@@ -29,10 +32,28 @@ class Point {
  public:
     noir::NoirSpace const * const noirSpace;
 
+    /*
+     * Creates a point whose coordinates are kept in a single allocation
+     * owned by the point.
+     */
     Point(const NoirSpace *noirSpace); 
 
+    /*
+     * Creates a point whose coordinates are kept in the specified storage,
+     * which must hold at least storage_size(noirSpace) bytes, aligned for a
+     * double, and must outlive the point. The point does not own the storage.
+     * If the storage is null, the point allocates its own.
+     */
+    Point(const NoirSpace *noirSpace, void *storage); 
+
     virtual ~Point();
 
+    /*
+     * Retrieve the number of bytes needed to store the coordinates of a
+     * point in the specified space.
+     */
+    static size_t storage_size( const NoirSpace *noirSpace );
+
 
     /*
      * Retrieve the value of the specified nominal coordinate.
@@ -89,6 +110,8 @@ class Point {
      */
     void set_interval_coordinate( const int& coordinate, const double& value ){
         intervals[coordinate] = value;
+        intervalSines[coordinate] = sin( M_PI*value );
+        intervalCosines[coordinate] = cos( M_PI*value );
     }
 
     /*
@@ -98,6 +121,24 @@ class Point {
         return intervals;
     }
 
+    /*
+     * Get a pointer to this point's array of sin(pi*x) for each interval
+     * coordinate x. Together with the cosines these allow the norm to
+     * evaluate sin(pi*(x - y)) = sin(pi*x)cos(pi*y) - cos(pi*x)sin(pi*y)
+     * from products alone.
+     */
+    double const * get_interval_sines() const {
+        return intervalSines;
+    }
+
+    /*
+     * Get a pointer to this point's array of cos(pi*x) for each interval
+     * coordinate x.
+     */
+    double const * get_interval_cosines() const {
+        return intervalCosines;
+    }
+
     /*
      * Retrieve the value of the specified real coordinate.
      */
@@ -124,7 +165,12 @@ class Point {
     int         *nominals;
     double      *ordinals;
     double      *intervals;
+    double      *intervalSines;
+    double      *intervalCosines;
     double      *reals;
+    char        *ownedStorage;
+
+    void init( void *storage );
 
     Point(const Point&) = delete;
     Point& operator=(const Point&) = delete;
@@ -0,0 +1,137 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "noir/point_columns.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+namespace noir {
+
+using std::vector;
+
+const size_t PointColumns::ALIGNMENT;
+
+namespace {
+
+/*
+ * Moves the first num_used values of the column into a new, aligned column
+ * of the specified capacity.
+ */
+template <typename T>
+void resize_column( T *&column, const size_t &num_used, 
+                    const size_t &capacity ){
+    void *memory = 0;
+    if ( posix_memalign( &memory, PointColumns::ALIGNMENT, 
+                         capacity*sizeof(T) ) != 0 ) {
+        throw std::bad_alloc();
+    }
+
+    T *resized = static_cast<T*>( memory );
+    if ( column != 0 ) {
+        memcpy( resized, column, num_used*sizeof(T) );
+        free( column );
+    }
+    column = resized;
+}
+
+template <typename T>
+void free_columns( vector<T*> &columns ){
+    typename vector<T*>::iterator cit;
+    for ( cit = columns.begin(); cit != columns.end(); ++cit ) {
+        free( *cit );
+    }
+}
+
+}  // namespace
+
+PointColumns::PointColumns( const NoirSpace *noir_space ) :
+                            noirSpace(noir_space), numPoints(0), capacity(0),
+                            nominals(noir_space->nominal, 0),
+                            ordinals(noir_space->ordinal, 0),
+                            intervals(noir_space->interval, 0),
+                            intervalSines(noir_space->interval, 0),
+                            intervalCosines(noir_space->interval, 0),
+                            reals(noir_space->real, 0) {}
+
+PointColumns::~PointColumns() {
+    free_columns( nominals );
+    free_columns( ordinals );
+    free_columns( intervals );
+    free_columns( intervalSines );
+    free_columns( intervalCosines );
+    free_columns( reals );
+}
+
+void PointColumns::reserve( const size_t &new_capacity ) {
+    if ( new_capacity <= capacity ) return;
+
+    // Pad each column to a whole number of 64 byte lines
+    size_t padded = (new_capacity + 15) & ~static_cast<size_t>(15);
+
+    for ( int n = 0; n < noirSpace->nominal; ++n ) {
+        resize_column( nominals[n], numPoints, padded );
+    }
+    for ( int o = 0; o < noirSpace->ordinal; ++o ) {
+        resize_column( ordinals[o], numPoints, padded );
+    }
+    for ( int i = 0; i < noirSpace->interval; ++i ) {
+        resize_column( intervals[i], numPoints, padded );
+        resize_column( intervalSines[i], numPoints, padded );
+        resize_column( intervalCosines[i], numPoints, padded );
+    }
+    for ( int r = 0; r < noirSpace->real; ++r ) {
+        resize_column( reals[r], numPoints, padded );
+    }
+
+    capacity = padded;
+}
+
+size_t PointColumns::add( const Point *point ) {
+    if ( numPoints == capacity ) {
+        reserve( capacity > 0 ? 2*capacity : 64 );
+    }
+
+    const int *p_nominals = point->get_nominal_coordinates();
+    for ( int n = 0; n < noirSpace->nominal; ++n ) {
+        nominals[n][numPoints] = p_nominals[n];
+    }
+
+    const double *p_ordinals = point->get_ordinal_coordinates();
+    for ( int o = 0; o < noirSpace->ordinal; ++o ) {
+        ordinals[o][numPoints] = p_ordinals[o];
+    }
+
+    const double *p_intervals = point->get_interval_coordinates();
+    const double *p_sines = point->get_interval_sines();
+    const double *p_cosines = point->get_interval_cosines();
+    for ( int i = 0; i < noirSpace->interval; ++i ) {
+        intervals[i][numPoints] = p_intervals[i];
+        intervalSines[i][numPoints] = p_sines[i];
+        intervalCosines[i][numPoints] = p_cosines[i];
+    }
+
+    const double *p_reals = point->get_real_coordinates();
+    for ( int r = 0; r < noirSpace->real; ++r ) {
+        reals[r][numPoints] = p_reals[r];
+    }
+
+    return numPoints++;
+}
+
+}  // namespace noir
@@ -0,0 +1,131 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef NOIR_POINT_COLUMNS_H
+#define NOIR_POINT_COLUMNS_H
+
+#include <cstddef>
+#include <vector>
+
+#include "noir/noir_space.h"
+#include "noir/point.h"
+
+namespace noir {
+
+/*
+ * A columnar (structure of arrays) copy of the coordinates of a set of points
+ * in a Noir space. Each coordinate is kept in its own contiguous column,
+ * aligned on a 64 byte boundary, and points are addressed by their index.
+ * Scanning a coordinate of all points therefore streams through memory
+ * rather than chasing a pointer per point.
+ */
+class PointColumns {
+ public:
+    // The alignment, in bytes, of every column
+    static const size_t ALIGNMENT = 64;
+
+    // The space in which these points live
+    NoirSpace const * const noirSpace;
+
+    explicit PointColumns(const NoirSpace *noirSpace);
+
+    virtual ~PointColumns();
+
+    /*
+     * Retrieve the number of points stored in the columns.
+     */
+    size_t size() const {
+        return numPoints;
+    }
+
+    /*
+     * Make room for at least the specified number of points.
+     */
+    void reserve( const size_t &capacity );
+
+    /*
+     * Appends the coordinates of the specified point and returns its index.
+     */
+    size_t add( const Point *point );
+
+    /*
+     * Removes all points. The memory is kept for reuse.
+     */
+    void clear() {
+        numPoints = 0;
+    }
+
+    /*
+     * Get a pointer to the column of the specified nominal coordinate.
+     */
+    int const * get_nominal_column( const int &coordinate ) const {
+        return nominals[coordinate];
+    }
+
+    /*
+     * Get a pointer to the column of the specified ordinal coordinate.
+     */
+    double const * get_ordinal_column( const int &coordinate ) const {
+        return ordinals[coordinate];
+    }
+
+    /*
+     * Get a pointer to the column of the specified interval coordinate.
+     */
+    double const * get_interval_column( const int &coordinate ) const {
+        return intervals[coordinate];
+    }
+
+    /*
+     * Get a pointer to the column of sin(pi*x) of the specified interval
+     * coordinate x.
+     */
+    double const * get_interval_sine_column( const int &coordinate ) const {
+        return intervalSines[coordinate];
+    }
+
+    /*
+     * Get a pointer to the column of cos(pi*x) of the specified interval
+     * coordinate x.
+     */
+    double const * get_interval_cosine_column( const int &coordinate ) const{
+        return intervalCosines[coordinate];
+    }
+
+    /*
+     * Get a pointer to the column of the specified real coordinate.
+     */
+    double const * get_real_column( const int &coordinate ) const {
+        return reals[coordinate];
+    }
+
+ private:
+    size_t numPoints;
+    size_t capacity;
+    std::vector<int*>    nominals;
+    std::vector<double*> ordinals;
+    std::vector<double*> intervals;
+    std::vector<double*> intervalSines;
+    std::vector<double*> intervalCosines;
+    std::vector<double*> reals;
+
+    PointColumns(const PointColumns&) = delete;
+    PointColumns& operator=(const PointColumns&) = delete;
+};
+
+}   // end namespace noir
+
+#endif   // NOIR_POINT_COLUMNS_H
@@ -0,0 +1,220 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "noir/vp_tree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace noir {
+
+using std::vector;
+
+namespace {
+
+// Slack on the pruning bounds, relative to the best distance, which absorbs
+// the rounding errors of the triangle inequality.
+const double PRUNING_SLACK = 1.0e-9;
+
+struct CompareDistance {
+    template <typename Item>
+    bool operator()( const Item &a, const Item &b ) const {
+        return a.dist < b.dist;
+    }
+};
+
+// Orders items by distance and then by position, so that the front of a heap
+// is the farthest item, the one with the highest position among equals
+struct CompareNeighbor {
+    template <typename Item>
+    bool operator()( const Item &a, const Item &b ) const {
+        return a.dist < b.dist || ( a.dist == b.dist && a.point < b.point );
+    }
+};
+
+}  // namespace
+
+VPTree::VPTree( const vector<const Point*> &points ) : points(points),
+                                                        nodes(), root(-1) {
+    vector<Item> items( points.size() );
+    for ( size_t p = 0; p < points.size(); ++p ) {
+        items[p].point = static_cast<int>(p);
+        items[p].dist = 0.0;
+    }
+
+    nodes.reserve( points.size() );
+    root = build( items, 0, items.size() );
+}
+
+int VPTree::build( vector<Item> &items, const size_t &begin, 
+                   const size_t &end ) {
+    if ( begin >= end ) return -1;
+
+    const Point *vantage = points[items[begin].point];
+    const Norm &norm = vantage->noirSpace->norm;
+
+    Node node;
+    node.point = items[begin].point;
+    node.radius = 0.0;
+    node.inner = -1;
+    node.outer = -1;
+
+    // Split the remaining points at the median distance from the vantage
+    // point: [begin+1,middle) lie within the radius, [middle,end) outside.
+    size_t middle = begin + 1 + (end - begin - 1)/2;
+    if ( begin + 1 < end ) {
+        for ( size_t k = begin + 1; k < end; ++k ) {
+            items[k].dist = norm( vantage, points[items[k].point] );
+        }
+        std::nth_element( items.begin() + begin + 1, items.begin() + middle,
+                          items.begin() + end, CompareDistance() );
+        node.radius = items[middle].dist;
+    }
+
+    int index = static_cast<int>(nodes.size());
+    nodes.push_back( node );
+
+    int inner = build( items, begin + 1, middle );
+    int outer = build( items, middle, end );
+    nodes[index].inner = inner;
+    nodes[index].outer = outer;
+
+    return index;
+}
+
+int VPTree::nearest( const Point *query, const int &exclude, 
+                     double &dist ) const {
+    int best = -1;
+    dist = std::numeric_limits<double>::max();
+    search( root, query, exclude, best, dist );
+    return best;
+}
+
+void VPTree::search( const int &index, const Point *query, const int &exclude,
+                     int &best, double &best_dist ) const {
+    if ( index < 0 ) return;
+
+    const Node &node = nodes[index];
+    double dist = query->noirSpace->norm( query, points[node.point] );
+
+    if ( node.point != exclude && 
+         ( dist < best_dist || ( dist == best_dist && node.point < best ) ) ) {
+        best = node.point;
+        best_dist = dist;
+    }
+
+    // Points of the inner subtree are at least dist - radius away from the
+    // query, those of the outer subtree at least radius - dist. Subtrees
+    // which might hold a point as near as the best one are searched, the
+    // more promising one first.
+    if ( dist < node.radius ) {
+        search( node.inner, query, exclude, best, best_dist );
+        if ( node.radius - dist <= best_dist*(1.0 + PRUNING_SLACK) + 
+                                                            PRUNING_SLACK ) {
+            search( node.outer, query, exclude, best, best_dist );
+        }
+    } else {
+        search( node.outer, query, exclude, best, best_dist );
+        if ( dist - node.radius <= best_dist*(1.0 + PRUNING_SLACK) + 
+                                                            PRUNING_SLACK ) {
+            search( node.inner, query, exclude, best, best_dist );
+        }
+    }
+}
+
+void VPTree::nearest( const Point *query, const int &exclude,
+                      const size_t &num_neighbors, vector<int> &neighbors,
+                      vector<double> &dists ) const {
+    vector<Item> found;
+    found.reserve( num_neighbors + 1 );
+    if ( num_neighbors > 0 ) {
+        search( root, query, exclude, num_neighbors, found );
+    }
+    std::sort_heap( found.begin(), found.end(), CompareNeighbor() );
+
+    neighbors.resize( found.size() );
+    dists.resize( found.size() );
+    for ( size_t k = 0; k < found.size(); ++k ) {
+        neighbors[k] = found[k].point;
+        dists[k] = found[k].dist;
+    }
+}
+
+void VPTree::search( const int &index, const Point *query, const int &exclude,
+                     const size_t &num_neighbors, vector<Item> &found ) const {
+    if ( index < 0 ) return;
+
+    const Node &node = nodes[index];
+    double dist = query->noirSpace->norm( query, points[node.point] );
+
+    // found is a heap of the nearest points so far, the farthest in front
+    Item item = { node.point, dist };
+    if ( node.point != exclude ) {
+        if ( found.size() < num_neighbors ) {
+            found.push_back( item );
+            std::push_heap( found.begin(), found.end(), CompareNeighbor() );
+        } else if ( CompareNeighbor()( item, found.front() ) ) {
+            std::pop_heap( found.begin(), found.end(), CompareNeighbor() );
+            found.back() = item;
+            std::push_heap( found.begin(), found.end(), CompareNeighbor() );
+        }
+    }
+
+    // As for a single neighbour, with the farthest of the nearest points
+    // found so far as the bound once there are enough of them
+    bool near_first = dist < node.radius;
+    search( near_first ? node.inner : node.outer, query, exclude, 
+            num_neighbors, found );
+    double bound = std::numeric_limits<double>::max();
+    if ( found.size() >= num_neighbors ) {
+        bound = found.front().dist*(1.0 + PRUNING_SLACK) + PRUNING_SLACK;
+    }
+    double gap = near_first ? node.radius - dist : dist - node.radius;
+    if ( gap <= bound ) {
+        search( near_first ? node.outer : node.inner, query, exclude,
+                num_neighbors, found );
+    }
+}
+
+bool VPTree::is_complete( const Point *point ) {
+    const NoirSpace *noirSpace = point->noirSpace;
+
+    const double *reals = point->get_real_coordinates();
+    for ( int r = 0; r < noirSpace->real; ++r ) {
+        if ( isnan(reals[r]) ) return false;
+    }
+
+    const double *intervals = point->get_interval_coordinates();
+    for ( int i = 0; i < noirSpace->interval; ++i ) {
+        if ( isnan(intervals[i]) ) return false;
+    }
+
+    const double *ordinals = point->get_ordinal_coordinates();
+    for ( int o = 0; o < noirSpace->ordinal; ++o ) {
+        if ( ordinals[o] == -1 ) return false;
+    }
+
+    const int *nominals = point->get_nominal_coordinates();
+    for ( int n = 0; n < noirSpace->nominal; ++n ) {
+        if ( nominals[n] == -1 ) return false;
+    }
+
+    return true;
+}
+
+}  // namespace noir
@@ -0,0 +1,110 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef NOIR_VP_TREE_H
+#define NOIR_VP_TREE_H
+
+#include <cstddef>
+#include <vector>
+
+#include "noir/noir_space.h"
+#include "noir/point.h"
+
+namespace noir {
+
+/*
+ * A vantage point tree for exact nearest neighbour queries in a Noir space.
+ *
+ * Each node holds a vantage point and the median distance (radius) from it
+ * to the points below the node; points within the radius go to the inner
+ * subtree, the others to the outer subtree. The triangle inequality then
+ * bounds the distance to every point of a subtree, so most subtrees can be
+ * skipped.
+ *
+ * Missing coordinates are ignored by the norm, for which the triangle
+ * inequality does not hold. The tree must therefore only contain, and only
+ * be queried with, complete points; see is_complete.
+ */
+class VPTree {
+ public:
+    /*
+     * Builds a tree over the specified points. The tree refers to the points
+     * by their position in the vector, which must outlive the tree.
+     */
+    explicit VPTree( const std::vector<const Point*> &points );
+
+    virtual ~VPTree() {}
+
+    /*
+     * Finds the point nearest to the specified query point, skipping the
+     * point at position exclude. Of several points at the same distance the
+     * one with the lowest position is chosen. Returns the position of the
+     * nearest point, or -1 if there is none, and stores its distance in dist.
+     */
+    int nearest( const Point *query, const int &exclude, double &dist ) const;
+
+    /*
+     * Finds the num_neighbors points nearest to the specified query point,
+     * skipping the point at position exclude. Their positions are stored in
+     * neighbors and their distances in dists, nearest first; of several
+     * points at the same distance the one with the lowest position comes
+     * first. Fewer points are returned if the tree holds fewer.
+     */
+    void nearest( const Point *query, const int &exclude, 
+                  const size_t &num_neighbors, std::vector<int> &neighbors,
+                  std::vector<double> &dists ) const;
+
+    /*
+     * Checks whether or not the specified point has all of its coordinates,
+     * i.e. no NaN real or interval coordinates and no -1 ordinal or nominal
+     * coordinates.
+     */
+    static bool is_complete( const Point *point );
+
+ private:
+    struct Node {
+        int point;
+        double radius;
+        int inner;
+        int outer;
+    };
+
+    struct Item {
+        int point;
+        double dist;
+    };
+
+    const std::vector<const Point*> &points;
+    std::vector<Node> nodes;
+    int root;
+
+    int build( std::vector<Item> &items, const size_t &begin,
+               const size_t &end );
+
+    void search( const int &node, const Point *query, const int &exclude,
+                 int &best, double &best_dist ) const;
+
+    void search( const int &node, const Point *query, const int &exclude,
+                 const size_t &num_neighbors, 
+                 std::vector<Item> &found ) const;
+
+    VPTree(const VPTree&) = delete;
+    VPTree& operator=(const VPTree&) = delete;
+};
+
+}   // end namespace noir
+
+#endif   // NOIR_VP_TREE_H
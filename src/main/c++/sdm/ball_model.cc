@@ -20,6 +20,7 @@
 #include <cmath>
 #include <cstdio>
 #include <limits>
+#include <new>
 #include <set>
 #include <vector>
 
@@ -62,7 +63,8 @@ void BallModel::expand( const Orthotope &region, CoveredPoint *nexus,
 
     //fprintf(stderr,"radius: %10.3e  %10.3e\n",radius,nn_dist);
 
-    Ball *ball = new Ball( noirSpace, radius );
+    Ball *ball = new (arena.allocate( sizeof(Ball), alignof(Ball) ))
+                        Ball( noirSpace, radius, &arena );
 
 // Select the Real Dimensions
 
@@ -136,9 +138,8 @@ void BallModel::expand( const Orthotope &region, CoveredPoint *nexus,
     for ( int n = 0; n < noirSpace->nominal; ++n ){
         int coordinate = nominals[n];
 
-        const set<int> allowed = region.get_nominals(n);
 
-        int max_allowable = static_cast<int>(allowed.size()) - 2;
+        int max_allowable = region.get_num_nominals(n) - 2;
 
 
         if ( coordinate != -1 && nn_nominals[n] != -1 ){
@@ -172,11 +173,16 @@ void BallModel::expand( const Orthotope &region, CoveredPoint *nexus,
 void BallModel::thicken(const Orthotope &region, Random *rand, 
                               const double &frac){
 
-    Ball *ball = dynamic_cast<Ball*>(spaces.back());
+    Ball *ball = spaces.back();
     double radius = ball->get_radius()/frac;
 
     ball->set_radius(radius);
 }
 
+Ball* BallModel::new_space( const NoirSpace *noirSpace ){
+    return new (arena.allocate( sizeof(Ball), alignof(Ball) ))
+               Ball( noirSpace, 0.0, &arena );
+}
+
 
 }  // namespace sdm
@@ -22,6 +22,8 @@
 
 #include "sdm/covered_point.h"
 #include "sdm/model.h"
+#include "sdm/space_model.h"
+#include "noir/ball.h"
 #include "noir/noir_space.h"
 #include "noir/orthotope.h"
 #include "rng/random.h"
@@ -31,13 +33,14 @@ namespace sdm {
 /*
  * This Model implementation consists of a union of Balls Noir Space.
  */
-class BallModel : public Model {
+class BallModel : public SpaceModel<noir::Ball> {
  public:
     BallModel(const int &principal_color, 
               const double &total_principal_colors,
               const double &total_other_colors):
-              Model( principal_color, total_principal_colors, 
-                     total_other_colors ) {}
+              SpaceModel<noir::Ball>( principal_color, 
+                                      total_principal_colors, 
+                                      total_other_colors ) {}
 
     virtual ~BallModel() {}
 
@@ -54,6 +57,9 @@ class BallModel : public Model {
      */
     void thicken( const noir::Orthotope &region, rng::Random *rand,
                  const double &frac );
+
+ protected:
+    noir::Ball* new_space( const noir::NoirSpace *noirSpace );
 };
 
 /*
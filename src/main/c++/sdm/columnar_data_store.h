@@ -0,0 +1,101 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef SDM_COLUMNAR_DATA_STORE_H
+#define SDM_COLUMNAR_DATA_STORE_H
+
+#include <cstddef>
+#include <vector>
+
+#include "noir/noir_space.h"
+#include "noir/point_columns.h"
+#include "sdm/data_point.h"
+
+namespace sdm {
+
+/*
+ * A variant of the DataStore which, besides the data points, keeps a
+ * columnar copy of their coordinates. Points are addressed by the index at
+ * which they were added, so that the closed spaces and the norm can scan
+ * whole columns of coordinates at a time.
+ *
+ * The data points are not owned by the store.
+ */
+class ColumnarDataStore {
+ public:
+    explicit ColumnarDataStore( const noir::NoirSpace *noirSpace ) :
+                                points(), colors(), columns(noirSpace) {}
+
+    virtual ~ColumnarDataStore() {}
+
+    /*
+     * Adds a data point to the data store and returns its index
+     */
+    inline size_t add( const DataPoint *p ) {
+        points.push_back( p );
+        colors.push_back( p->get_color() );
+        return columns.add( p );
+    }
+
+    /*
+     * Retrieve the number of data points in the store
+     */
+    inline size_t size() const {
+        return points.size();
+    }
+
+    /*
+     * Retrieve the data point at the specified index
+     */
+    inline const DataPoint* operator[]( const size_t &index ) const {
+        return points[index];
+    }
+
+    /*
+     * Retrieve the color (class) of the data point at the specified index
+     */
+    inline int get_color( const size_t &index ) const {
+        return colors[index];
+    }
+
+    /*
+     * Retrieve the columns holding the coordinates of the data points
+     */
+    inline const noir::PointColumns& get_columns() const {
+        return columns;
+    }
+
+    /*
+     * Removes all data points from the data store
+     */
+    inline void clear() {
+        points.clear();
+        colors.clear();
+        columns.clear();
+    }
+
+ private:
+    std::vector<const DataPoint*> points;
+    std::vector<int> colors;
+    noir::PointColumns columns;
+
+    ColumnarDataStore(const ColumnarDataStore&) = delete;
+    ColumnarDataStore& operator=(const ColumnarDataStore&) = delete;
+};
+
+}   // end namespace sdm
+
+#endif   // SDM_COLUMNAR_DATA_STORE_H
@@ -0,0 +1,387 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "sdm/compiled_discriminator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "sdm/orthotope_model.h"
+#include "util/invalid_input_error.h"
+
+namespace sdm {
+
+using std::numeric_limits;
+using std::vector;
+
+using noir::Orthotope;
+using noir::Point;
+using noir::PointColumns;
+
+// The number of points whose bitsets are intersected together
+static const size_t COMPILED_BLOCK = 256;
+
+namespace {
+
+/*
+ * Whether or not the value lies within the bounds of a coordinate, as
+ * Orthotope::in_closure decides it. The bounds of a periodic coordinate
+ * wrap around if the upper bound is below the lower one.
+ */
+bool within( const double &lower, const double &upper, const double &value,
+             const bool &periodic ) {
+    if ( periodic && upper < lower ) {
+        return !( ( value < lower ) && ( value > upper ) );
+    }
+    return !( ( value < lower ) || ( value > upper ) );
+}
+
+// The bitset of the orthotopes containing a single point, kept by each
+// thread from call to call
+thread_local vector<uint64_t> point_bits;
+
+/*
+ * Whether or not any of the bits [first,last) is set.
+ */
+bool any_bit( const uint64_t *bits, size_t first, const size_t &last ) {
+    while ( first < last ) {
+        size_t offset = first % 64;
+        size_t count = 64 - offset;
+        if ( count > last - first ) count = last - first;
+        uint64_t word = bits[first/64] >> offset;
+        if ( count < 64 ) word &= ( static_cast<uint64_t>(1) << count ) - 1;
+        if ( word != 0 ) return true;
+        first += count;
+    }
+    return false;
+}
+
+}  // namespace
+
+CompiledDiscriminator::CompiledDiscriminator( 
+                                    const Discriminator &discriminator ) :
+                    numSpaces(0), numWords(0), nominalAxes(), ordinalAxes(),
+                    intervalAxes(), realAxes(), modelSpaces(), 
+                    coveredValues(), uncoveredValues() {
+
+    const vector<Model*> &models = discriminator.get_models();
+
+    vector<const Orthotope*> spaces;
+    for ( size_t m = 0; m < models.size(); ++m ) {
+        const OrthotopeModel *model = 
+                            dynamic_cast<const OrthotopeModel*>( models[m] );
+        if ( model == 0 ) {
+            throw util::InvalidInputError( __FILE__, __LINE__,
+                "Only discriminators of orthotope models can be compiled." );
+        }
+
+        modelSpaces.push_back( spaces.size() );
+        coveredValues.push_back( model->characteristic( true ) );
+        uncoveredValues.push_back( model->characteristic( false ) );
+        for ( int s = 0; s < model->get_num_elements(); ++s ) {
+            spaces.push_back( model->get_space( s ) );
+        }
+    }
+    modelSpaces.push_back( spaces.size() );
+
+    numSpaces = spaces.size();
+    numWords = (numSpaces + 63)/64;
+    if ( numSpaces == 0 ) return;
+
+    const noir::NoirSpace *noirSpace = spaces[0]->noirSpace;
+    for ( int n = 0; n < noirSpace->nominal; ++n ) {
+        compile_nominal( spaces, n );
+    }
+    for ( int o = 0; o < noirSpace->ordinal; ++o ) {
+        compile_axis( spaces, Ordinal, o, ordinalAxes );
+    }
+    for ( int i = 0; i < noirSpace->interval; ++i ) {
+        compile_axis( spaces, Interval, i, intervalAxes );
+    }
+    for ( int r = 0; r < noirSpace->real; ++r ) {
+        compile_axis( spaces, Real, r, realAxes );
+    }
+}
+
+size_t CompiledDiscriminator::estimate_size( 
+                                    const Discriminator &discriminator ) {
+    const vector<Model*> &models = discriminator.get_models();
+
+    size_t num_spaces = 0;
+    const noir::NoirSpace *noirSpace = 0;
+    int limit = 0;
+    for ( size_t m = 0; m < models.size(); ++m ) {
+        const OrthotopeModel *model = 
+                            dynamic_cast<const OrthotopeModel*>( models[m] );
+        if ( model == 0 ) continue;
+        for ( int s = 0; s < model->get_num_elements(); ++s ) {
+            const Orthotope *space = model->get_space( s );
+            noirSpace = space->noirSpace;
+            limit = std::max( limit, space->get_nominal_limit() );
+            ++num_spaces;
+        }
+    }
+    if ( num_spaces == 0 ) return 0;
+
+    // A bounded coordinate has at most two breakpoints per orthotope, and
+    // twice as many cells plus one
+    size_t num_masks = noirSpace->nominal*static_cast<size_t>( limit );
+    size_t num_bounded = noirSpace->ordinal + noirSpace->interval + 
+                         noirSpace->real;
+    num_masks += num_bounded*( 4*num_spaces + 1 );
+
+    size_t num_words = (num_spaces + 63)/64;
+    return num_masks*num_words*sizeof(uint64_t) +
+           num_bounded*2*num_spaces*sizeof(double);
+}
+
+size_t CompiledDiscriminator::get_size() const {
+    size_t size = 0;
+    for ( size_t a = 0; a < nominalAxes.size(); ++a ) {
+        size += nominalAxes[a].values.size()*sizeof(uint64_t);
+    }
+    const vector<Axis> *axes[] = { &ordinalAxes, &intervalAxes, &realAxes };
+    for ( size_t k = 0; k < 3; ++k ) {
+        for ( size_t a = 0; a < axes[k]->size(); ++a ) {
+            const Axis &axis = (*axes[k])[a];
+            size += axis.cells.size()*sizeof(uint64_t) +
+                    axis.breakpoints.size()*sizeof(double);
+        }
+    }
+    return size;
+}
+
+void CompiledDiscriminator::compile_nominal( 
+                                    const vector<const Orthotope*> &spaces,
+                                    const int &coordinate ) {
+    NominalAxis axis;
+    axis.coordinate = coordinate;
+    axis.limit = 0;
+    for ( size_t s = 0; s < numSpaces; ++s ) {
+        axis.limit = std::max( axis.limit, spaces[s]->get_nominal_limit() );
+    }
+
+    axis.values.assign( axis.limit*numWords, 0 );
+    for ( int v = 0; v < axis.limit; ++v ) {
+        uint64_t *mask = &axis.values[v*numWords];
+        for ( size_t s = 0; s < numSpaces; ++s ) {
+            if ( spaces[s]->allows_nominal( coordinate, v ) ) {
+                mask[s/64] |= static_cast<uint64_t>(1) << (s % 64);
+            }
+        }
+    }
+
+    nominalAxes.push_back( axis );
+}
+
+void CompiledDiscriminator::compile_axis( 
+                                    const vector<const Orthotope*> &spaces,
+                                    const Kind &kind, const int &coordinate,
+                                    vector<Axis> &axes ) {
+    vector<double> lower( numSpaces );
+    vector<double> upper( numSpaces );
+    for ( size_t s = 0; s < numSpaces; ++s ) {
+        if ( kind == Ordinal ) {
+            spaces[s]->get_ordinal_boundaries( coordinate, lower[s], upper[s] );
+        } else if ( kind == Interval ) {
+            spaces[s]->get_interval_boundaries( coordinate, 
+                                                lower[s], upper[s] );
+        } else {
+            spaces[s]->get_real_boundaries( coordinate, lower[s], upper[s] );
+        }
+    }
+
+    Axis axis;
+    axis.coordinate = coordinate;
+    for ( size_t s = 0; s < numSpaces; ++s ) {
+        if ( !std::isnan( lower[s] ) ) axis.breakpoints.push_back( lower[s] );
+        if ( !std::isnan( upper[s] ) ) axis.breakpoints.push_back( upper[s] );
+    }
+    std::sort( axis.breakpoints.begin(), axis.breakpoints.end() );
+    axis.breakpoints.erase( std::unique( axis.breakpoints.begin(), 
+                                         axis.breakpoints.end() ),
+                            axis.breakpoints.end() );
+
+    // The membership of each cell is that of any of its values: the
+    // breakpoint itself, or the value next to the breakpoint below
+    const vector<double> &breakpoints = axis.breakpoints;
+    size_t num_cells = 2*breakpoints.size() + 1;
+    axis.cells.assign( num_cells*numWords, 0 );
+
+    for ( size_t c = 0; c < num_cells; ++c ) {
+        double value;
+        if ( c % 2 == 1 ) {
+            value = breakpoints[c/2];
+        } else if ( c == 0 ) {
+            value = -numeric_limits<double>::infinity();
+        } else if ( c == num_cells - 1 ) {
+            value = numeric_limits<double>::infinity();
+        } else {
+            value = std::nextafter( breakpoints[c/2 - 1], breakpoints[c/2] );
+        }
+
+        uint64_t *mask = &axis.cells[c*numWords];
+        for ( size_t s = 0; s < numSpaces; ++s ) {
+            if ( within( lower[s], upper[s], value, kind == Interval ) ) {
+                mask[s/64] |= static_cast<uint64_t>(1) << (s % 64);
+            }
+        }
+    }
+
+    axes.push_back( axis );
+}
+
+const uint64_t* CompiledDiscriminator::find_cell( const Axis &axis, 
+                                            const double &value ) const {
+    const vector<double> &breakpoints = axis.breakpoints;
+    size_t i = std::lower_bound( breakpoints.begin(), breakpoints.end(),
+                                 value ) - breakpoints.begin();
+    size_t cell = 2*i;
+    if ( i < breakpoints.size() && breakpoints[i] == value ) ++cell;
+    return &axis.cells[cell*numWords];
+}
+
+void CompiledDiscriminator::intersect( uint64_t *inside,
+                                       const uint64_t *mask ) const {
+    for ( size_t w = 0; w < numWords; ++w ) {
+        inside[w] &= mask[w];
+    }
+}
+
+double CompiledDiscriminator::score( const uint64_t *inside ) const {
+    // Summed in the order of the models, as by Discriminator::test
+    size_t num_models = coveredValues.size();
+    double prediction = 0.0;
+    for ( size_t m = 0; m < num_models; ++m ) {
+        bool covered = any_bit( inside, modelSpaces[m], modelSpaces[m+1] );
+        prediction += covered ? coveredValues[m] : uncoveredValues[m];
+    }
+    prediction /= static_cast<double>(num_models);
+
+    return prediction;
+}
+
+double CompiledDiscriminator::test( const Point *point ) const {
+    vector<uint64_t> &inside = point_bits;
+    inside.assign( numWords, ~static_cast<uint64_t>(0) );
+
+    // Missing coordinates never put a point outside an orthotope
+    const int *nominals = point->get_nominal_coordinates();
+    for ( size_t a = 0; a < nominalAxes.size(); ++a ) {
+        const NominalAxis &axis = nominalAxes[a];
+        int value = nominals[axis.coordinate];
+        if ( value == -1 ) continue;
+        if ( value < 0 || value >= axis.limit ) {
+            inside.assign( numWords, 0 );
+        } else {
+            intersect( &inside[0], &axis.values[value*numWords] );
+        }
+    }
+
+    const double *ordinals = point->get_ordinal_coordinates();
+    for ( size_t a = 0; a < ordinalAxes.size(); ++a ) {
+        double value = ordinals[ordinalAxes[a].coordinate];
+        if ( value == -1 || std::isnan( value ) ) continue;
+        intersect( &inside[0], find_cell( ordinalAxes[a], value ) );
+    }
+
+    const double *intervals = point->get_interval_coordinates();
+    for ( size_t a = 0; a < intervalAxes.size(); ++a ) {
+        double value = intervals[intervalAxes[a].coordinate];
+        if ( std::isnan( value ) ) continue;
+        intersect( &inside[0], find_cell( intervalAxes[a], value ) );
+    }
+
+    const double *reals = point->get_real_coordinates();
+    for ( size_t a = 0; a < realAxes.size(); ++a ) {
+        double value = reals[realAxes[a].coordinate];
+        if ( std::isnan( value ) ) continue;
+        intersect( &inside[0], find_cell( realAxes[a], value ) );
+    }
+
+    return score( inside.empty() ? 0 : &inside[0] );
+}
+
+void CompiledDiscriminator::test( const PointColumns &points, 
+                                  const size_t &begin, const size_t &end,
+                                  double *prediction ) const {
+    vector<uint64_t> inside( COMPILED_BLOCK*numWords );
+    uint64_t *bits = inside.empty() ? 0 : &inside[0];
+
+    // The bitsets of a block of points are intersected one coordinate at a
+    // time, so that the breakpoints of a coordinate stay in cache
+    for ( size_t first = begin; first < end; first += COMPILED_BLOCK ) {
+        size_t last = first + COMPILED_BLOCK;
+        if ( last > end ) last = end;
+        size_t num_points = last - first;
+        std::fill( inside.begin(), inside.begin() + num_points*numWords,
+                   ~static_cast<uint64_t>(0) );
+
+        for ( size_t a = 0; a < nominalAxes.size(); ++a ) {
+            const NominalAxis &axis = nominalAxes[a];
+            const int *values = points.get_nominal_column( axis.coordinate );
+            for ( size_t k = 0; k < num_points; ++k ) {
+                int value = values[first + k];
+                if ( value == -1 ) continue;
+                uint64_t *point_bits = bits + k*numWords;
+                if ( value < 0 || value >= axis.limit ) {
+                    std::fill( point_bits, point_bits + numWords, 0 );
+                } else {
+                    intersect( point_bits, &axis.values[value*numWords] );
+                }
+            }
+        }
+
+        for ( size_t a = 0; a < ordinalAxes.size(); ++a ) {
+            const Axis &axis = ordinalAxes[a];
+            const double *values = points.get_ordinal_column( axis.coordinate );
+            for ( size_t k = 0; k < num_points; ++k ) {
+                double value = values[first + k];
+                if ( value == -1 || std::isnan( value ) ) continue;
+                intersect( bits + k*numWords, find_cell( axis, value ) );
+            }
+        }
+
+        for ( size_t a = 0; a < intervalAxes.size(); ++a ) {
+            const Axis &axis = intervalAxes[a];
+            const double *values = 
+                            points.get_interval_column( axis.coordinate );
+            for ( size_t k = 0; k < num_points; ++k ) {
+                double value = values[first + k];
+                if ( std::isnan( value ) ) continue;
+                intersect( bits + k*numWords, find_cell( axis, value ) );
+            }
+        }
+
+        for ( size_t a = 0; a < realAxes.size(); ++a ) {
+            const Axis &axis = realAxes[a];
+            const double *values = points.get_real_column( axis.coordinate );
+            for ( size_t k = 0; k < num_points; ++k ) {
+                double value = values[first + k];
+                if ( std::isnan( value ) ) continue;
+                intersect( bits + k*numWords, find_cell( axis, value ) );
+            }
+        }
+
+        for ( size_t k = 0; k < num_points; ++k ) {
+            prediction[first - begin + k] = score( bits + k*numWords );
+        }
+    }
+}
+
+}  // namespace sdm
@@ -0,0 +1,141 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef SDM_COMPILED_DISCRIMINATOR_H
+#define SDM_COMPILED_DISCRIMINATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "noir/orthotope.h"
+#include "noir/point.h"
+#include "noir/point_columns.h"
+#include "sdm/discriminator.h"
+
+namespace sdm {
+
+/*
+ * A Compiled Discriminator is a flat, read-only form of a trained
+ * discriminator of orthotope models, used for scoring.
+ *
+ * The orthotopes of all models are numbered in the order of the models.
+ * For each coordinate, the bounds of all orthotopes are sorted into
+ * breakpoints, which cut the axis into cells: the breakpoints themselves and
+ * the open intervals between them. No orthotope begins or ends within a
+ * cell, so each cell records the orthotopes containing it in a bitset. A
+ * point is then scored by one binary search per coordinate and the
+ * intersection of the bitsets found, instead of testing every coordinate of
+ * every orthotope.
+ *
+ * The scores are the same as those of Discriminator::test.
+ *
+ * The bitsets take about S*S/2 bytes per bounded coordinate for S
+ * orthotopes, so the size of the tables should be estimated with
+ * estimate_size before a discriminator of many models is compiled.
+ */
+class CompiledDiscriminator {
+ public:
+    /*
+     * Compiles the models of the specified discriminator, which must all be
+     * orthotope models.
+     */
+    explicit CompiledDiscriminator( const Discriminator &discriminator );
+
+    virtual ~CompiledDiscriminator() {}
+
+    /*
+     * Estimates, from above, the number of bytes of the tables into which
+     * the specified discriminator would be compiled.
+     */
+    static size_t estimate_size( const Discriminator &discriminator );
+
+    /*
+     * Retrieve the number of bytes of the tables of this discriminator.
+     */
+    size_t get_size() const;
+
+    /*
+     * Retrieve the number of orthotopes of all models.
+     */
+    size_t get_num_spaces() const {
+        return numSpaces;
+    }
+
+    /*
+     * Determine the probability that the specified point is a member of
+     * the class specialized by the discriminator.
+     */
+    double test( const noir::Point *point ) const;
+
+    /*
+     * Determine, for each of the points [begin,end) of the specified
+     * columns, the probability that it is a member of the class specialized
+     * by the discriminator. The probability for point begin+k is stored in
+     * prediction[k].
+     */
+    void test( const noir::PointColumns &points, const size_t &begin,
+               const size_t &end, double *prediction ) const;
+
+ private:
+    // The kinds of bounded coordinates, whose membership is tested alike
+    enum Kind { Ordinal, Interval, Real };
+
+    // The breakpoints along a bounded coordinate and the bitset of each of
+    // its cells; cell 2i+1 is breakpoint i, cell 2i the values below it
+    struct Axis {
+        int coordinate;
+        std::vector<double> breakpoints;
+        std::vector<uint64_t> cells;
+    };
+
+    // The bitset of each value of a nominal coordinate below the limit
+    struct NominalAxis {
+        int coordinate;
+        int limit;
+        std::vector<uint64_t> values;
+    };
+
+    size_t numSpaces;
+    size_t numWords;
+    std::vector<NominalAxis> nominalAxes;
+    std::vector<Axis> ordinalAxes;
+    std::vector<Axis> intervalAxes;
+    std::vector<Axis> realAxes;
+
+    // The first orthotope of each model, followed by the number of
+    // orthotopes, and the characteristic values of each model
+    std::vector<size_t> modelSpaces;
+    std::vector<double> coveredValues;
+    std::vector<double> uncoveredValues;
+
+    void compile_nominal( const std::vector<const noir::Orthotope*> &spaces,
+                          const int &coordinate );
+    void compile_axis( const std::vector<const noir::Orthotope*> &spaces,
+                       const Kind &kind, const int &coordinate,
+                       std::vector<Axis> &axes );
+
+    const uint64_t* find_cell( const Axis &axis, const double &value ) const;
+    void intersect( uint64_t *inside, const uint64_t *mask ) const;
+    double score( const uint64_t *inside ) const;
+
+    CompiledDiscriminator(const CompiledDiscriminator&) = delete;
+    CompiledDiscriminator& operator=(const CompiledDiscriminator&) = delete;
+};
+
+}   // end namespace sdm
+
+#endif   // SDM_COMPILED_DISCRIMINATOR_H
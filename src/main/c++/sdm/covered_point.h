@@ -17,20 +17,18 @@
 #ifndef SDM_COVERED_POINT_H
 #define SDM_COVERED_POINT_H
 
-#include <functional>
-
 #include "noir/noir_space.h"
 #include "sdm/data_point.h"
 
 namespace sdm {
 
 /*
- * A wrapper around a Point which tracks the Point's coverage during the
- * learning stage.
+ * A wrapper around a Point used during the learning stage. The Point's
+ * coverage is tracked by the TrainingData the wrapper belongs to.
  */
 class CoveredPoint {
  public:
-    CoveredPoint(const DataPoint *p): point(p), coverage(0.0) {}
+    CoveredPoint(const DataPoint *p): point(p), principalIndex(-1) {}
 
     virtual ~CoveredPoint(){}
 
@@ -46,20 +44,16 @@ class CoveredPoint {
         return point->get_color();
     }
 
-    double get_coverage() const {
-        return coverage;
-    }
-
-    void clear_coverage() {
-        coverage = 0.0;
+    /*
+     * Retrieve the position of this point among the principal color points
+     * of the training data it belongs to, or -1 if it is of another color.
+     */
+    int get_principal_index() const {
+        return principalIndex;
     }
 
-    void increment_coverage( const double inc ) {
-        coverage += inc;
-    }
-
-    void increment_coverage() {
-        ++coverage;
+    void set_principal_index( const int &index ) {
+        principalIndex = index;
     }
 
     const noir::NoirSpace* get_noir_space() const {
@@ -98,16 +92,9 @@ class CoveredPoint {
         return point->get_real_coordinates();
     }
 
-    struct CompareCoverage :
-             public std::binary_function< CoveredPoint*, CoveredPoint*, bool> {
-        bool operator()(const CoveredPoint* x, const CoveredPoint* y) const {
-            return ( x->get_coverage() < y->get_coverage() ? true : false );
-        }
-    };
-
  private:
     const DataPoint *point;
-    double coverage;
+    int principalIndex;
 
     CoveredPoint(const CoveredPoint&) = delete;
     CoveredPoint& operator=(const CoveredPoint&) = delete;
@@ -21,6 +21,7 @@
 #include <cmath>
 #include <iterator>
 #include <limits>
+#include <new>
 #include <set>
 #include <string>
 #include <vector>
@@ -43,6 +44,7 @@ using std::numeric_limits;
 
 using noir::NoirSpace;
 using noir::Orthotope;
+using noir::Point;
 using rng::Random;
 using util::CSVReader;
 using util::to_numeric;
@@ -52,6 +54,9 @@ using util::trim;
 using util::Properties;
 
 DataManager::~DataManager(){
+    for ( unsigned c = 0; c < nnCaches.size(); c++ ) {
+        delete nnCaches[c];
+    }
     if ( folds.size() > 1 ) {
         for ( unsigned f = 0; f < folds.size(); f++ ) {
             delete folds[f];
@@ -240,6 +245,20 @@ void DataManager::load_trial_data( const string &filename ) {
 }
 
 
+/*
+ * Creates a data point in the point arena. The point and its coordinates
+ * share a single allocation and are freed together with the data manager.
+ */
+DataPoint* DataManager::create_point( const int &id, const int &color ) {
+    const size_t header = (sizeof(DataPoint) + sizeof(double) - 1) &
+                                                ~(sizeof(double) - 1);
+    char *memory = static_cast<char*>( pointArena.allocate(
+                     header + Point::storage_size( noirSpace ), 
+                     alignof(DataPoint) ) );
+
+    return new (memory) DataPoint( id, color, noirSpace, memory + header );
+}
+
 void DataManager::load_data( const string &filename, DataStore &dataStore ) {
 
     CSVReader csvReader( filename );
@@ -295,7 +314,7 @@ void DataManager::load_data( const string &filename, DataStore &dataStore ) {
             id++;
         }
 
-        DataPoint *point = new DataPoint( id, color, noirSpace);
+        DataPoint *point = create_point( id, color );
 
         // Get the nominal valued features
         for ( int n = 0; n < nominal_dimensions; ++n ) {
@@ -369,25 +388,7 @@ void DataManager::load_data( const string &filename, DataStore &dataStore ) {
     double lambda = 1.01;
     double ilambda = 0.99;
     if ( enclosure == 0 ) {
-        enclosure = new Orthotope( noirSpace );
-
-        for ( int n = 0; n < noirSpace->nominal; n++ ) {
-            int max_nominal = nominalValues[n]->size();
-            for ( int nn = 0; nn < max_nominal; nn++ ) {
-                enclosure->add_nominal(n, nn);
-            }
-        }
-
-        for ( int o = 0; o < noirSpace->ordinal; o++ ) {
-            //int max = ordinalValues[o]->size() + 1;
-            //double dmax = static_cast<double>(max);
-            enclosure->set_ordinal_boundaries(o, 0.0, 1.0 );
-        }
-
-        for ( int i = 0; i < noirSpace->interval; i++ ) {
-            enclosure->set_interval_boundaries(i, 0.0, 1.0 );
-        }
-
+        create_enclosure();
 
         for ( int r = 0; r < noirSpace->real; r++ ) {
             double min =  real_min_max[r][0];
@@ -406,8 +407,6 @@ void DataManager::load_data( const string &filename, DataStore &dataStore ) {
                 max *= ilambda;
             }
             real_min_max[r][1] = max;
-
-            enclosure->set_real_boundaries(r, 0.0, 1.0 );
         }
     }
 
@@ -438,6 +437,97 @@ void DataManager::load_data( const string &filename, DataStore &dataStore ) {
     delete[] real_min_max;
 };
 
+void DataManager::create_enclosure() {
+    enclosure = new Orthotope( noirSpace );
+
+    for ( int n = 0; n < noirSpace->nominal; n++ ) {
+        int max_nominal = nominalValues[n]->size();
+        for ( int nn = 0; nn < max_nominal; nn++ ) {
+            enclosure->add_nominal(n, nn);
+        }
+    }
+
+    for ( int o = 0; o < noirSpace->ordinal; o++ ) {
+        //int max = ordinalValues[o]->size() + 1;
+        //double dmax = static_cast<double>(max);
+        enclosure->set_ordinal_boundaries(o, 0.0, 1.0 );
+    }
+
+    for ( int i = 0; i < noirSpace->interval; i++ ) {
+        enclosure->set_interval_boundaries(i, 0.0, 1.0 );
+    }
+
+    for ( int r = 0; r < noirSpace->real; r++ ) {
+        enclosure->set_real_boundaries(r, 0.0, 1.0 );
+    }
+}
+
+void DataManager::write_scales( util::BinaryWriter &out ) {
+    out.write_int( colors.size() );
+    for ( size_t c = 0; c < colors.size(); c++ ) {
+        out.write_string( colors.ascribe( c ) );
+    }
+
+    write_scales( out, nominalValues, nominalFields.size() );
+    write_scales( out, ordinalValues, ordinalFields.size() );
+}
+
+void DataManager::write_scales( util::BinaryWriter &out,
+                                const vector<NominalScale*> &scales,
+                                const size_t &num_scales ) {
+    out.write_int( num_scales );
+    for ( size_t n = 0; n < num_scales; n++ ) {
+        NominalScale *scale = scales[n];
+        out.write_int( scale->size() );
+        for ( size_t v = 0; v < scale->size(); v++ ) {
+            out.write_string( scale->ascribe( v ) );
+        }
+    }
+}
+
+void DataManager::read_scales( util::BinaryReader &in ) {
+    colors = NominalScale();
+    int64_t num_colors = in.read_int();
+    for ( int64_t c = 0; c < num_colors; c++ ) {
+        colors.mark( in.read_string() );
+    }
+
+    read_scales( in, nominalValues, nominalFields.size() );
+    read_scales( in, ordinalValues, ordinalFields.size() );
+
+    if ( noirSpace == 0 ) {
+        noirSpace = new NoirSpace( nominalFields.size(), ordinalFields.size(),
+                                   intervalFields.size(), realFields.size() );
+    }
+    delete enclosure;
+    create_enclosure();
+}
+
+void DataManager::read_scales( util::BinaryReader &in,
+                               vector<NominalScale*> &scales,
+                               const size_t &num_scales ) {
+    int64_t dimensions = in.read_int();
+    if ( dimensions != static_cast<int64_t>(num_scales) ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                "Expected scales for " + to_string(num_scales) +
+                " fields, but found " + to_string(dimensions) + "." );
+    }
+
+    for ( unsigned n = 0; n < scales.size(); n++ ) {
+        delete scales[n];
+    }
+    scales.clear();
+
+    for ( int64_t n = 0; n < dimensions; n++ ) {
+        NominalScale *scale = new NominalScale();
+        scales.push_back( scale );
+        int64_t num_values = in.read_int();
+        for ( int64_t v = 0; v < num_values; v++ ) {
+            scale->mark( in.read_string() );
+        }
+    }
+}
+
 void DataManager::partition_training_data( const int &num_folds,
                                            Random *rand ) {
     if ( num_folds < 2 ) {
@@ -467,4 +557,17 @@ void DataManager::partition_training_data( const int &num_folds,
     }
 }
 
+void DataManager::build_nn_caches( const int &num_neighbors,
+                                   util::ThreadPool *thread_pool ) {
+    for ( unsigned c = 0; c < nnCaches.size(); c++ ) {
+        delete nnCaches[c];
+    }
+    nnCaches.clear();
+
+    for ( int c = 0; c < get_num_colors(); c++ ) {
+        nnCaches.push_back( new NearestNeighborCache( folds, c, num_neighbors,
+                                                      thread_pool ) );
+    }
+}
+
 }  // namespace sdm
@@ -26,10 +26,14 @@
 #include "rng/random.h"
 #include "sdm/data_store.h"
 #include "sdm/model.h"
+#include "sdm/nearest_neighbor_cache.h"
 #include "sdm/nominal_scale.h"
 #include "sdm/training_data.h"
+#include "util/arena.h"
+#include "util/binary_file.h"
 #include "util/misc.h"
 #include "util/properties.h"
+#include "util/thread_pool.h"
 
 namespace sdm {
 
@@ -39,12 +43,12 @@ namespace sdm {
 class DataManager {
  public:
     DataManager():trainingData(), testData(), trialData(), enclosure(0), 
-                  folds(),
+                  folds(), nnCaches(),
                   delimiter(util::Delimiters::COMMA), colors(), noirSpace(0),
                   skipLines(), nominalFields(), ordinalFields(), 
                   intervalFields(),
                   realFields(), nominalValues(), ordinalValues(),
-                  numFields(2), idField(-1), colorField(1) {}
+                  numFields(2), idField(-1), colorField(1), pointArena() {}
 
     virtual ~DataManager();
 
@@ -69,6 +73,22 @@ class DataManager {
     void load_trial_data( const std::string &filename );
 
 
+    /*
+     * Writes the scales by which further data is transcribed as the data
+     * loaded so far: the labels of the colors and of the values of each
+     * nominal and ordinal coordinate, in the order of their indices.
+     */
+    void write_scales( util::BinaryWriter &out );
+
+    /*
+     * Reads scales written by write_scales in place of any marked so far,
+     * so that data loaded afterwards is transcribed as the data from which
+     * they were written. The numbers of fields set by init must agree.
+     * The enclosure is made from them, too, so that data loaded afterwards
+     * is also scaled as data loaded after the training data.
+     */
+    void read_scales( util::BinaryReader &in );
+
     /*
      * Partitions the training data into the specified number of folds
      */
@@ -93,6 +113,26 @@ class DataManager {
             return NULL;
     }
 
+    /*
+     * Finds, for each color, the specified number of nearest neighbours of
+     * every point of the partitioned training data, using the specified pool
+     * of threads, if any. The folds then derive their nearest neighbours
+     * from these instead of searching anew.
+     */
+    void build_nn_caches( const int &num_neighbors, 
+                          util::ThreadPool *thread_pool = 0 );
+
+    /*
+     * Retrieve the nearest neighbour cache of the specified color, or 0 if
+     * there is none.
+     */
+    const NearestNeighborCache* get_nn_cache( const int &color ) const {
+        if ( color >= 0 && color < static_cast<int>(nnCaches.size()) )
+            return nnCaches[color];
+        else
+            return 0;
+    }
+
     /*
      * Retrieve the test data
      */
@@ -114,6 +154,14 @@ class DataManager {
         return colors.size();
     }
 
+    /*
+     * Returns the Noir space of the data loaded last, or 0 if no data has
+     * been loaded yet.
+     */
+    const noir::NoirSpace* get_noir_space() const {
+        return noirSpace;
+    }
+
     /*
      * Returns the hyper-rectangle which encloses all the data.
      */
@@ -141,6 +189,7 @@ class DataManager {
     DataStore trialData;
     noir::Orthotope *enclosure;
     std::vector<DataStore*> folds;
+    std::vector<NearestNeighborCache*> nnCaches;
     std::string delimiter;
     NominalScale colors;
     noir::NoirSpace *noirSpace;
@@ -155,8 +204,18 @@ class DataManager {
     size_t numFields;
     int idField;
     int colorField;
+    util::Arena pointArena;
+
+    DataPoint* create_point( const int &id, const int &color );
 
     void load_data( const std::string &filename, DataStore &dataStore );
+    void create_enclosure();
+    void write_scales( util::BinaryWriter &out,
+                       const std::vector<NominalScale*> &scales,
+                       const size_t &num_scales );
+    void read_scales( util::BinaryReader &in,
+                      std::vector<NominalScale*> &scales,
+                      const size_t &num_scales );
 
     template<typename ValueType>
     inline int parse_single_value(const util::Properties &parameters,
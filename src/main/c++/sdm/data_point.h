@@ -32,6 +32,14 @@ class DataPoint : public noir::Point{
                const noir::NoirSpace *space ) : 
                noir::Point(space), id(id), color(color) {}
 
+    /*
+     * Creates a data point whose coordinates are kept in the specified
+     * storage; see noir::Point.
+     */
+    DataPoint( const int& id, const int& color, 
+               const noir::NoirSpace *space, void *storage ) : 
+               noir::Point(space, storage), id(id), color(color) {}
+
     virtual ~DataPoint() {}
 
 
@@ -34,9 +34,27 @@ using std::string;
 using std::vector;
 using std::numeric_limits;
 
+using noir::PointColumns;
 using util::CSVReader;
 using util::to_string;
 
+// The number of training points handled by a single task
+static const size_t POINTS_PER_TASK = 1024;
+
+// The number of points scored together, model by model, by the batched test
+static const size_t SCORING_BLOCK = 512;
+
+template <typename Function>
+void Discriminator::parallel_for( const size_t &first, const size_t &last,
+                                  const size_t &grain,
+                                  const Function &function ){
+    if ( threadPool != 0 ) {
+        threadPool->parallel_for( first, last, grain, function );
+    } else if ( first < last ) {
+        function( first, last );
+    }
+}
+
 void Discriminator::add_training_data( DataStore *data ){
 
     DataStore::const_iterator pit;
@@ -67,140 +85,254 @@ void Discriminator::check_data_consistency(){
 void Discriminator::create_models_rc( const int &num_models, 
                                       const int &num_spaces ){
     check_data_consistency();
-    trainingData.find_nn() ;
-
-    vector<CoveredPoint *>::iterator pit;
+    trainingData.find_nn( threadPool );
 
     numUnfinished = 0;
 
-    double avg_cov = 0.0;
-    bool not_finished = false;
-    for ( int m = 0; m < num_models; m++ ){
-        double lpf = lowerFrac;
-        double upf = upperFrac;
+    // Without random streams, generate one model at a time
+    int batch_size = static_cast<int>( randomStreams.size() );
+    if ( batch_size < 2 ) batch_size = 1;
 
-        double norm = 1.0;
-        if ( models.size() > 0 ) {
-            norm = 1.0/static_cast<double>(models.size());
+    vector<Model*> candidates( batch_size );
+    vector<vector<size_t> > covered( batch_size );
+
+    double avg_cov = 0.0;
+    for ( int m = 0; m < num_models; m += batch_size ){
+        int num_candidates = num_models - m;
+        if ( num_candidates > batch_size ) num_candidates = batch_size;
+
+        if ( num_candidates == 1 ) {
+            rng::Random *random = batch_size == 1 ? rand : randomStreams[0];
+            candidates[0] = generate_model_rc( random, num_spaces, avg_cov,
+                                               covered[0] );
+        } else {
+            // Generate the candidates against the current coverage ...
+            const double snapshot_cov = avg_cov;
+            parallel_for( 0, num_candidates, 1,
+                          [this, &candidates, &covered, &num_spaces,
+                           &snapshot_cov] ( size_t begin, size_t end ) {
+                for ( size_t c = begin; c < end; ++c ) {
+                    candidates[c] = generate_model_rc( randomStreams[c], 
+                                          num_spaces, snapshot_cov, 
+                                          covered[c] );
+                }
+            });
         }
 
-        //Generate a random model
-        Model *model = modelFactory->get_model(principalColor, 
-                                           numPrincipalColor, numOtherColor);
+        // ... and commit them in order if they are still acceptable
+        for ( int c = 0; c < num_candidates; ++c ) {
+            if ( candidates[c] == 0 ) continue;
+            if ( !commit_model_rc( candidates[c], covered[c], avg_cov ) ) {
+                delete candidates[c];
+            }
+        }
+    }
 
-        //Add points to the model
-        int t;
-        for ( t = 0; t < num_spaces; t++ ){
-            CoveredPoint *nexus = trainingData.get_random_point();
-            CoveredPoint *nn = trainingData.get_nn(nexus);
-            model->expand( *boundary, nexus, nn, rand, lpf, upf );
+    training_data_prob_distribution();
+};
 
-            if ( nexus == 0) {
-                fprintf(stderr,"nexus does not exist!\n");
-            }
-            if ( !(model->covers(nexus)) ) {
-                fprintf(stderr,"nexus not covered!\n");
-            }
-            if ( nn == 0) {
-                fprintf(stderr,"neighbor does not exist!\n");
-            }
-            if ( !(model->covers(nn)) ) {
-                double dist = nexus->get_data_point()->noirSpace->norm(
-                                        nexus->get_data_point(),
-                                        nn->get_data_point() );
-                fprintf(stderr,"c: %d  neighbor not covered! %10.3e\n",
-                                    principalColor,dist);
+/*
+ * Checks the training points against the specified model, in parallel, and
+ * updates the model's registers of checked points. Only the points not yet
+ * covered are tested, and only against the subspaces added since the last
+ * check. On return covered[p] is non-zero if, and only if, the p-th training
+ * point has the principal color and is covered by the model.
+ */
+void Discriminator::check_points( Model *model, vector<char> &covered ){
+    size_t num_points = trainingData.size();
+    size_t num_blocks = (num_points + POINTS_PER_TASK - 1)/POINTS_PER_TASK;
+
+    covered.assign( num_points, 0 );
+    vector<int> num_pc( num_blocks, 0 );
+    vector<int> num_oc( num_blocks, 0 );
+
+    model->begin_checking_points( num_points );
+
+    // POINTS_PER_TASK is a multiple of 64, so no two blocks share a word of
+    // the model's set of covered points.
+    const ColumnarDataStore &data = trainingData.get_columnar_data();
+
+    parallel_for( 0, num_points, POINTS_PER_TASK,
+                  [this, model, &data, &covered, &num_pc, &num_oc] 
+                  ( size_t begin, size_t end ) {
+        size_t block = begin/POINTS_PER_TASK;
+        vector<char> newly_covered( end - begin );
+        model->check_points( data.get_columns(), begin, end, 
+                             &newly_covered[0] );
+
+        for ( size_t p = begin; p < end; ++p ){
+            if ( !model->is_covered_point( p ) ) continue;
+            if ( data.get_color( p ) == principalColor ) {
+                covered[p] = 1;
+                if ( newly_covered[p - begin] ) ++num_pc[block];
+            } else {
+                if ( newly_covered[p - begin] ) ++num_oc[block];
             }
+        }
+    });
 
-            //Check the average coverage of points in this model
+    int model_pc = 0;
+    int model_oc = 0;
+    for ( size_t b = 0; b < num_blocks; ++b ){
+        model_pc += num_pc[b];
+        model_oc += num_oc[b];
+    }
+    model->commit_checked_points( model_pc, model_oc );
+}
 
-            model->clear_checked_points();
+/*
+ * Grows a random model until it is enriched and uniform with respect to the
+ * specified average coverage. If such a model is found it is returned and the
+ * positions of the covered principal color points are stored in the 
+ * specified vector, otherwise the model is deleted and 0 is returned.
+ *
+ * Only the model and the random number generator are modified, so several
+ * models can be generated at the same time.
+ */
+Model* Discriminator::generate_model_rc( rng::Random *random, 
+                                         const int &num_spaces,
+                                         const double &avg_cov,
+                                         vector<size_t> &covered ){
+    double lpf = lowerFrac;
+    double upf = upperFrac;
+
+    double norm = 1.0;
+    if ( models.size() > 0 ) {
+        norm = 1.0/static_cast<double>(models.size());
+    }
 
-            double avg_mod_cov = 0.0;
-            double num_mod_cov = 0.0;
-            for (pit = trainingData.begin(); pit < trainingData.end(); ++pit){
-                if ( model->check_point( *pit ) ) {
-                        avg_mod_cov += (*pit)->get_coverage()*norm;
-                        num_mod_cov += 1.0;
-                }
-            }
-            avg_mod_cov /=  num_mod_cov;
+    //Generate a random model
+    Model *model = modelFactory->get_model(principalColor, 
+                                       numPrincipalColor, numOtherColor);
 
-            double model_pc = 
-                        static_cast<double>(model->get_num_principal_color());
-            double model_oc = 
-                        static_cast<double>(model->get_num_other_color());
+    vector<char> in_model;
 
-            //If we have to many points in the model, then break and start over
+    //Add points to the model
+    for ( int t = 0; t < num_spaces; t++ ){
+        CoveredPoint *nexus = trainingData.get_random_point( random );
+        CoveredPoint *nn = trainingData.get_nn(nexus);
+        model->expand( *boundary, nexus, nn, random, lpf, upf );
 
-/*
-            fprintf(stderr,"c: %d t:  %d  ns:  %d total: %f  %f  %f %f %f \n",
-                principalColor, t, model->get_num_elements(),
-                model_total, numPrincipalColor,numOtherColor,
-                    avg_mod_cov, avg_cov);
-*/
+        if ( nexus == 0) {
+            fprintf(stderr,"nexus does not exist!\n");
+        }
+        if ( !(model->covers(nexus)) ) {
+            fprintf(stderr,"nexus not covered!\n");
+        }
+        if ( nn == 0) {
+            fprintf(stderr,"neighbor does not exist!\n");
+        }
+        if ( !(model->covers(nn)) ) {
+            double dist = nexus->get_data_point()->noirSpace->norm(
+                                    nexus->get_data_point(),
+                                    nn->get_data_point() );
+            fprintf(stderr,"c: %d  neighbor not covered! %10.3e\n",
+                                principalColor,dist);
+        }
 
+        //Check the average coverage of points in this model
 
-            if ( model_pc == numPrincipalColor ) {
-                break;
-            }
+        check_points( model, in_model );
+        covered.clear();
 
+        double avg_mod_cov = 0.0;
+        double num_mod_cov = 0.0;
+        size_t num_points = trainingData.size();
+        for ( size_t p = 0; p < num_points; ++p ){
+            if ( in_model[p] ) {
+                    avg_mod_cov += trainingData.get_coverage(p)*norm;
+                    num_mod_cov += 1.0;
+                    covered.push_back( p );
+            }
+        }
+        avg_mod_cov /=  num_mod_cov;
 
-            double ratio_diff = model_pc/numPrincipalColor - 
-                                                model_oc/numOtherColor;
+        double model_pc = 
+                    static_cast<double>(model->get_num_principal_color());
+        double model_oc = 
+                    static_cast<double>(model->get_num_other_color());
 
-            //Check for richness
-            if ( ratio_diff >= enrichmentLevel ){
-                double delta = avg_mod_cov - avg_cov;
-                if (delta < 0.1 || models.size() == 0){
-                    not_finished = false;
-                    double avg_cov_m = 0.0;
-                    for (pit = trainingData.begin(); pit < trainingData.end(); 
-                                                                    ++pit){
-                        if ( (*pit)->get_color() == principalColor ) {
-                            if ( model->covers(*pit) ) {
-                                (*pit)->increment_coverage(1.0);
-                                double cov =  (*pit)->get_coverage()*norm;
-                                avg_cov_m += cov;
-                            }
-                        }
-                    }
-                    avg_cov_m /= model_pc;
-                    if ( models.size() == 0 ) {
-                        avg_cov = avg_cov_m;
-                    } else {
-                        avg_cov += (avg_cov_m - avg_cov)/
-                                        static_cast<double>(models.size()+1);
-                    }
-                    models.push_back( model );
-                    break;
-                }
-            }
+        //If we have to many points in the model, then break and start over
+        if ( model_pc == numPrincipalColor ) {
+            break;
         }
 
-        //if no enriched model could be created, delete the current model
-        //and try again with different points.
-        if ( not_finished ){
-            delete model;
-            if ( t == num_spaces ){
-                ++numUnfinished;
+        double ratio_diff = model_pc/numPrincipalColor - 
+                                            model_oc/numOtherColor;
+
+        //Check for richness and uniformity
+        if ( ratio_diff >= enrichmentLevel ){
+            double delta = avg_mod_cov - avg_cov;
+            if (delta < 0.1 || models.size() == 0){
+                return model;
             }
         }
     }
 
-    training_data_prob_distribution();
-};
+    //No enriched model could be created
+    delete model;
+    return 0;
+}
+
+/*
+ * Adds the specified model, generated by generate_model_rc, to this
+ * discriminator's models if it is still uniform with respect to the current
+ * coverage. The coverage of the covered points is then updated.
+ */
+bool Discriminator::commit_model_rc( Model *model, 
+                                     const vector<size_t> &covered,
+                                     double &avg_cov ){
+    double norm = 1.0;
+    if ( models.size() > 0 ) {
+        norm = 1.0/static_cast<double>(models.size());
+    }
+
+    // Models accepted since the model was generated may have changed the
+    // coverage, so check its uniformity again
+    double avg_mod_cov = 0.0;
+    vector<size_t>::const_iterator cit;
+    for ( cit = covered.begin(); cit != covered.end(); ++cit ){
+        avg_mod_cov += trainingData.get_coverage(*cit)*norm;
+    }
+    avg_mod_cov /= static_cast<double>( covered.size() );
+
+    double delta = avg_mod_cov - avg_cov;
+    if ( !(delta < 0.1 || models.size() == 0) ) {
+        return false;
+    }
+
+    double model_pc = static_cast<double>(model->get_num_principal_color());
+
+    double avg_cov_m = 0.0;
+    for ( cit = covered.begin(); cit != covered.end(); ++cit ){
+        trainingData.increment_coverage( *cit, 1.0 );
+        double cov =  trainingData.get_coverage(*cit)*norm;
+        avg_cov_m += cov;
+    }
+    avg_cov_m /= model_pc;
+    if ( models.size() == 0 ) {
+        avg_cov = avg_cov_m;
+    } else {
+        avg_cov += (avg_cov_m - avg_cov)/
+                        static_cast<double>(models.size()+1);
+    }
+    model->freeze();
+    models.push_back( model );
+
+    return true;
+}
 
 
 void Discriminator::create_models_lc( const int &num_models, 
                                       const int &num_spaces ){
 
     check_data_consistency();
-    trainingData.find_nn() ;
+    trainingData.find_nn( threadPool );
 
     trainingData.reorder();
 
-    vector<CoveredPoint *>::iterator pit;
+    size_t num_points = trainingData.size();
+    vector<char> in_model;
 
     numUnfinished = 0;
 
@@ -256,25 +388,19 @@ void Discriminator::create_models_lc( const int &num_models,
             }
 
 
-            model->clear_checked_points();
+            check_points( model, in_model );
 
             //Check the average coverage of points in this model
             double avg_mod_cov = 0.0;
             if ( test_cov ) {
                 double num_mod_cov = 0.0;
-                for (pit = trainingData.begin(); pit < trainingData.end(); 
-                                                                       ++pit){
-                    if ( model->check_point( *pit ) ) {
-                        avg_mod_cov += (*pit)->get_coverage()*norm;
+                for ( size_t p = 0; p < num_points; ++p ){
+                    if ( in_model[p] ) {
+                        avg_mod_cov += trainingData.get_coverage(p)*norm;
                         num_mod_cov += 1.0;
                     }
                 }
                 avg_mod_cov /=  num_mod_cov;
-            } else {
-                for (pit = trainingData.begin(); pit < trainingData.end(); 
-                                                                      ++pit){
-                    model->check_point( *pit );
-                }
             }
 
             double model_pc = 
@@ -297,17 +423,17 @@ void Discriminator::create_models_lc( const int &num_models,
                 //covered point
                 if (!test_cov || avg_mod_cov < avg_cov || models.size() == 0){
                     not_finished = false;
+                    model->freeze();
+
+                    // Updating the coverage keeps the points ordered by it
                     double avg_cov_m = 0.0;
-                    for (pit = trainingData.begin(); pit < trainingData.end(); 
-                                                                    ++pit){
-                        if ( (*pit)->get_color() == principalColor ) {
-                            double inc = 
-                                    model->characteristic(
-                                                (*pit)->get_data_point());
-                            (*pit)->increment_coverage(inc);
-                            double cov =  (*pit)->get_coverage()*norm;
-                            avg_cov_m += cov;
+                    for ( size_t p = 0; p < num_points; ++p ){
+                        if ( trainingData[p]->get_color() != principalColor ){
+                            continue;
                         }
+                        double inc = model->characteristic( in_model[p] != 0 );
+                        trainingData.increment_coverage( p, inc );
+                        avg_cov_m += trainingData.get_coverage(p)*norm;
                     }
                     avg_cov_m /= model_pc;
                     if ( models.size() == 0 ) {
@@ -317,7 +443,6 @@ void Discriminator::create_models_lc( const int &num_models,
                                         static_cast<double>(models.size()+1);
                     }
                     models.push_back( model );
-                    trainingData.reorder();
                     if (test_cov) rank = 0;
                     break;
                 } 
@@ -328,7 +453,7 @@ void Discriminator::create_models_lc( const int &num_models,
             lpf *= 1.10;
 
             // make the last space a bit thicker
-            model->thicken( *boundary, rand, 0.8);
+            model->grow_last_space( *boundary, rand, 0.8);
         }
 
         //if could not find an enriched model after max tries, delete the
@@ -354,15 +479,22 @@ void Discriminator::training_data_prob_distribution(){
     double npc = 0.0;
     double opc = 0.0;
 
-    vector<CoveredPoint *>::iterator pit;
-    for ( pit = trainingData.begin(); 
-          pit < trainingData.end(); ++pit ){
-        if ( (*pit)->get_color() == principalColor ) {
-            npc = test( (*pit)->get_data_point() );
+    // Score the training points in parallel, but sum them up in order
+    size_t num_points = trainingData.size();
+    vector<double> scores( num_points, 0.0 );
+    parallel_for( 0, num_points, POINTS_PER_TASK,
+                  [this, &scores] ( size_t begin, size_t end ) {
+        test( trainingData.get_columnar_data().get_columns(), begin, end,
+              &scores[begin] );
+    });
+
+    for ( size_t p = 0; p < num_points; ++p ){
+        if ( trainingData[p]->get_color() == principalColor ) {
+            npc = scores[p];
             avg_pc += npc;
             avg2_pc += (npc*npc);
         } else {
-            opc = test( (*pit)->get_data_point() );
+            opc = scores[p];
             avg_oc += opc;
             avg2_oc += (opc*opc);
         }
@@ -410,8 +542,94 @@ double Discriminator::test( const DataPoint* point ){
     return prediction;
 }
 
+void Discriminator::test( const PointColumns &points, const size_t &begin,
+                          const size_t &end, double *prediction ){
+    size_t num_points = end - begin;
+    for ( size_t k = 0; k < num_points; ++k ) {
+        prediction[k] = 0.0;
+    }
+
+    // The contributions of the models are added in the order of the models,
+    // as in the test of a single point, so the sums are the same
+    unsigned num_models = models.size();
+    char covered[SCORING_BLOCK];
+    for ( size_t first = begin; first < end; first += SCORING_BLOCK ) {
+        size_t last = first + SCORING_BLOCK;
+        if ( last > end ) last = end;
+        double *block_prediction = prediction + (first - begin);
+
+        for ( unsigned m = 0; m < num_models; ++m ) {
+            const Model *model = models[m];
+            model->covers( points, first, last, covered );
+
+            double inside = model->characteristic( true );
+            double outside = model->characteristic( false );
+            for ( size_t k = 0; k < last - first; ++k ) {
+                block_prediction[k] += covered[k] ? inside : outside;
+            }
+        }
+    }
+
+    for ( size_t k = 0; k < num_points; ++k ) {
+        prediction[k] /= static_cast<double>(num_models);
+    }
+}
+
+void Discriminator::select_training_data( const vector<DataStore*> &folds,
+                                          const int &skip_fold ){
+    trainingData.select( folds, skip_fold );
+    clear_models();
+}
+
+void Discriminator::write( util::BinaryWriter &out ) const {
+    out.write_int( principalColor );
+    out.write_double( numPrincipalColor );
+    out.write_double( numOtherColor );
+    out.write_double( threshold );
+    out.write_int( numUnfinished );
+
+    out.write_int( models.size() );
+    vector<Model*>::const_iterator mit;
+    for ( mit = models.begin(); mit != models.end(); ++mit ){
+        (*mit)->write( out );
+    }
+}
+
+void Discriminator::read( util::BinaryReader &in, 
+                          const noir::NoirSpace *noirSpace ){
+    if ( modelFactory == 0 ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+            "A discriminator can only be read once a model factory is set." );
+    }
+
+    int principal_color = static_cast<int>( in.read_int() );
+    if ( principal_color != principalColor ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+            "Expected a discriminator of color " + to_string(principalColor) +
+            ", but found one of color " + to_string(principal_color) + "." );
+    }
+    numPrincipalColor = in.read_double();
+    numOtherColor = in.read_double();
+    threshold = in.read_double();
+    numUnfinished = static_cast<int>( in.read_int() );
+
+    clear_models();
+    int64_t num_models = in.read_int();
+    for ( int64_t m = 0; m < num_models; ++m ) {
+        Model *model = modelFactory->get_model( principalColor, 
+                                                numPrincipalColor,
+                                                numOtherColor );
+        models.push_back( model );
+        model->read( in, noirSpace );
+    }
+}
+
 void Discriminator::clear(){
     trainingData.clear();
+    clear_models();
+}
+
+void Discriminator::clear_models(){
     vector<Model*>::const_iterator mit;
     for (mit = models.begin(); mit != models.end(); ++mit){
         delete *mit;
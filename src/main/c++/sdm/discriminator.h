@@ -25,6 +25,8 @@
 #include "sdm/model.h"
 #include "sdm/training_data.h"
 #include "rng/random.h"
+#include "util/binary_file.h"
+#include "util/thread_pool.h"
 
 namespace sdm{
 
@@ -39,7 +41,7 @@ class Discriminator {
                    trainingData( principal_color ), 
                    modelFactory(0),
                    models(),
-                   boundary(0), rand(0),
+                   boundary(0), rand(0), randomStreams(), threadPool(0),
                    numPrincipalColor(0.0), 
                    numOtherColor(0.0),threshold(1.0),
                    lowerFrac(0.0), upperFrac(0.1), enrichmentLevel(0.1),
@@ -48,6 +50,7 @@ class Discriminator {
     virtual ~Discriminator(){
         clear();
         delete modelFactory;
+        set_random_streams( std::vector<rng::Random*>() );
     }
 
     /*
@@ -57,6 +60,20 @@ class Discriminator {
         return principalColor;
     }
 
+    /*
+     * Retrieve the models learned by this discriminator.
+     */
+    const std::vector<Model*>& get_models() const {
+        return models;
+    }
+
+    /*
+     * Retrieve the training data of this discriminator.
+     */
+    const TrainingData& get_training_data() const {
+        return trainingData;
+    }
+
     /*
      * Set the random number generator to use.
      */
@@ -65,6 +82,45 @@ class Discriminator {
         trainingData.set_random( rand );
     }
 
+    /*
+     * Set the random number generators used to generate models
+     * speculatively, one for each model of a batch. The number of
+     * generators is the size of the batches. With fewer than two generators
+     * the models are generated one at a time. The discriminator takes
+     * ownership of the generators.
+     */
+    void set_random_streams( const std::vector<rng::Random*> &streams ){
+        std::vector<rng::Random*>::const_iterator rit;
+        for ( rit = randomStreams.begin(); rit != randomStreams.end(); ++rit ){
+            delete *rit;
+        }
+        randomStreams = streams;
+    }
+
+    /*
+     * Set the pool of threads used to share out the work of this
+     * discriminator. Without a pool all work is done by the calling thread.
+     */
+    void set_thread_pool( util::ThreadPool *thread_pool ){
+        threadPool = thread_pool;
+    }
+
+    /*
+     * Set the way in which the nearest neighbours of the training points
+     * are found.
+     */
+    void set_nn_search( const NearestNeighborSearch::Types &nn_search ){
+        trainingData.set_nn_search( nn_search );
+    }
+
+    /*
+     * Set the cache of nearest neighbours found for all folds, or 0 to find
+     * them anew from the training data.
+     */
+    void set_nn_cache( const NearestNeighborCache *nn_cache ){
+        trainingData.set_nn_cache( nn_cache );
+    }
+
     /*
      * Set the factory used to generate models.
      */
@@ -106,12 +162,26 @@ class Discriminator {
      */
     void add_training_data( DataStore *data );
 
+    /*
+     * Removes all the models and uses the points of all of the specified
+     * folds but skip_fold as the training data. Switching between the folds
+     * of the same set does not allocate any points.
+     */
+    void select_training_data( const std::vector<DataStore*> &folds,
+                               const int &skip_fold );
+
     /*
      * This method creates models using the least covered point as the model's
      * nexus
      */
     void create_models_lc( const int &num_models, const int &num_spaces );
 
+    /*
+     * This method creates models using randomly chosen points as the models'
+     * nexus. If random streams have been set, batches of models are generated
+     * in parallel against the coverage at the start of the batch and then
+     * committed in order, provided they are still acceptable.
+     */
     void create_models_rc( const int &num_models, const int &num_spaces );
 
     /*
@@ -120,6 +190,33 @@ class Discriminator {
      */
     double test( const DataPoint *point );
 
+    /*
+     * Determine, for each of the points [begin,end) of the specified
+     * columns, the probability that it is a member of the class specialized
+     * by this discriminator. The probability for point begin+k is stored in
+     * prediction[k] and equals that given by test for the single point.
+     *
+     * The points are scored in blocks, model by model, so that the subspaces
+     * of a model stay in cache while a whole block of points is tested.
+     */
+    void test( const noir::PointColumns &points, const size_t &begin,
+               const size_t &end, double *prediction );
+
+    /*
+     * Writes the learned state of this discriminator: its principal color,
+     * the numbers of training points of either kind, the threshold and the
+     * models. A record of orthotope models can be scored in place by a
+     * DiscriminatorView.
+     */
+    void write( util::BinaryWriter &out ) const;
+
+    /*
+     * Reads a discriminator written by write in place of the models held,
+     * creating the models with the factory set and their subspaces in the
+     * specified space. The principal colors must agree.
+     */
+    void read( util::BinaryReader &in, const noir::NoirSpace *noirSpace );
+
     /*
      * Removes all the data and all the models
      */
@@ -136,6 +233,8 @@ class Discriminator {
     std::vector<Model*> models;
     const noir::Orthotope *boundary;
     rng::Random  *rand;
+    std::vector<rng::Random*> randomStreams;
+    util::ThreadPool *threadPool;
     double  numPrincipalColor;
     double  numOtherColor;
     double  threshold;
@@ -146,6 +245,19 @@ class Discriminator {
     int     numUnfinished;
 
     void training_data_prob_distribution();
+    void clear_models();
+
+    void check_points( Model *model, std::vector<char> &covered );
+
+    Model* generate_model_rc( rng::Random *random, const int &num_spaces,
+                              const double &avg_cov, 
+                              std::vector<size_t> &covered );
+    bool commit_model_rc( Model *model, const std::vector<size_t> &covered,
+                          double &avg_cov );
+
+    template <typename Function>
+    void parallel_for( const size_t &first, const size_t &last,
+                       const size_t &grain, const Function &function );
 
     Discriminator(const Discriminator&) = delete;
     Discriminator& operator=(const Discriminator&) = delete;
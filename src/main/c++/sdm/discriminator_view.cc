@@ -0,0 +1,104 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "sdm/discriminator_view.h"
+
+#include "sdm/model_view.h"
+#include "util/invalid_input_error.h"
+
+namespace sdm {
+
+using noir::NoirSpace;
+using noir::Point;
+using noir::PointColumns;
+
+DiscriminatorView::DiscriminatorView( const NoirSpace *noir_space,
+                                      const char *record,
+                                      const size_t &available ) :
+                            noirSpace(noir_space), models(0), numModels(0),
+                            principalColor(0), recordSize(0) {
+    const size_t header_size = HEADER_SIZE*sizeof(int64_t);
+    if ( available < header_size ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                        "A discriminator record ends before its models." );
+    }
+
+    const int64_t *header = reinterpret_cast<const int64_t*>( record );
+    if ( header[NUM_MODELS] < 0 ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                        "Invalid number of models of a discriminator." );
+    }
+    principalColor = static_cast<int>( header[PRINCIPAL_COLOR] );
+    numModels = static_cast<size_t>( header[NUM_MODELS] );
+    models = record + header_size;
+
+    // The records are checked once here, so that scoring can trust them
+    recordSize = header_size;
+    for ( size_t m = 0; m < numModels; ++m ) {
+        recordSize += ModelView::check_record( noirSpace, record + recordSize,
+                                               available - recordSize );
+    }
+}
+
+double DiscriminatorView::test( const Point *point ) const {
+    const char *record = models;
+    double prediction = 0.0;
+    for ( size_t m = 0; m < numModels; ++m ) {
+        ModelView model( noirSpace, record );
+        prediction += model.characteristic( model.covers( point ) );
+        record += model.get_record_size();
+    }
+    prediction /= static_cast<double>(numModels);
+
+    return prediction;
+}
+
+void DiscriminatorView::test( const PointColumns &points, 
+                              const size_t &begin, const size_t &end, 
+                              double *prediction ) const {
+    size_t num_points = end - begin;
+    for ( size_t k = 0; k < num_points; ++k ) {
+        prediction[k] = 0.0;
+    }
+
+    // The contributions of the models are added in the order of the models,
+    // as by Discriminator::test, so the sums are the same
+    char covered[SCORING_BLOCK];
+    for ( size_t first = begin; first < end; first += SCORING_BLOCK ) {
+        size_t last = first + SCORING_BLOCK;
+        if ( last > end ) last = end;
+        double *block_prediction = prediction + (first - begin);
+
+        const char *record = models;
+        for ( size_t m = 0; m < numModels; ++m ) {
+            ModelView model( noirSpace, record );
+            model.covers( points, first, last, covered );
+
+            double inside = model.characteristic( true );
+            double outside = model.characteristic( false );
+            for ( size_t k = 0; k < last - first; ++k ) {
+                block_prediction[k] += covered[k] ? inside : outside;
+            }
+            record += model.get_record_size();
+        }
+    }
+
+    for ( size_t k = 0; k < num_points; ++k ) {
+        prediction[k] /= static_cast<double>(numModels);
+    }
+}
+
+}   // end namespace sdm
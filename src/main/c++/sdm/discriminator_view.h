@@ -0,0 +1,109 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef SDM_DISCRIMINATOR_VIEW_H
+#define SDM_DISCRIMINATOR_VIEW_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "noir/noir_space.h"
+#include "noir/point.h"
+#include "noir/point_columns.h"
+
+namespace sdm {
+
+/*
+ * A Discriminator View is a read-only counterpart of a trained discriminator
+ * of orthotope models, which scores points in place over the record written
+ * by Discriminator::write, e.g. in a file of saved discriminators mapped
+ * into memory. The models are evaluated one after the other as ModelViews,
+ * so nothing is copied or allocated, and processes mapping the same file
+ * share its pages.
+ *
+ * The scores are the same as those of Discriminator::test.
+ */
+class DiscriminatorView {
+ public:
+    /*
+     * Creates a view of the discriminator record starting at the specified
+     * address, aligned to eight bytes, in the specified space. The record
+     * is checked to lie within the specified number of bytes; it must stay
+     * in place while the view is used.
+     */
+    DiscriminatorView( const noir::NoirSpace *noirSpace, const char *record,
+                       const size_t &available );
+
+    virtual ~DiscriminatorView() {}
+
+    /*
+     * Retrieves the principal color (class) for this discriminator.
+     */
+    int get_principal_color() const {
+        return principalColor;
+    }
+
+    /*
+     * Retrieves the number of models of this discriminator.
+     */
+    size_t get_num_models() const {
+        return numModels;
+    }
+
+    /*
+     * Retrieves the size in bytes of the record of this discriminator.
+     */
+    size_t get_record_size() const {
+        return recordSize;
+    }
+
+    /*
+     * Determine the probability that the specified point is a member of
+     * the class specialized by the discriminator.
+     */
+    double test( const noir::Point *point ) const;
+
+    /*
+     * Determine, for each of the points [begin,end) of the specified
+     * columns, the probability that it is a member of the class specialized
+     * by the discriminator. The probability for point begin+k is stored in
+     * prediction[k].
+     */
+    void test( const noir::PointColumns &points, const size_t &begin,
+               const size_t &end, double *prediction ) const;
+
+ private:
+    // The positions of the values of a discriminator record ahead of its
+    // models
+    enum Header { PRINCIPAL_COLOR, NUM_PRINCIPAL_COLOR, NUM_OTHER_COLOR,
+                  THRESHOLD, NUM_UNFINISHED, NUM_MODELS, HEADER_SIZE };
+
+    // The number of points scored by all models before the next block
+    static const size_t SCORING_BLOCK = 512;
+
+    const noir::NoirSpace *noirSpace;
+    const char *models;
+    size_t numModels;
+    int principalColor;
+    size_t recordSize;
+
+    DiscriminatorView(const DiscriminatorView&) = delete;
+    DiscriminatorView& operator=(const DiscriminatorView&) = delete;
+};
+
+}   // end namespace sdm
+
+#endif   // SDM_DISCRIMINATOR_VIEW_H
@@ -25,6 +25,7 @@
 #include "noir/noir_space.h"
 #include "noir/orthotope.h"
 #include "rng/random.h"
+#include "util/invalid_input_error.h"
 
 namespace sdm {
 
@@ -33,60 +34,165 @@ using std::set;
 using std::vector;
 
 using noir::NoirSpace;
-using noir::ClosedSpace;
 using noir::Orthotope;
+using noir::PointColumns;
 using rng::Random;
 
-
 bool Model::check_point( const CoveredPoint *p ){
-    vector<ClosedSpace*>::const_iterator nsit;
-
-    bool covered = false;
-    for ( nsit = spaces.begin(); nsit != spaces.end(); ++nsit ) {
-        if ( (*nsit)->in_closure( p->get_data_point() ) ){
-            if ( p->get_color() == principalColor ){
-                ++numPrincipalColor;
-                covered = true;
-            } else {
-                ++numOtherColor;
-            }
-            break;
-        }
-    }
+    frozen = false;
+    if ( !in_spaces( p->get_data_point() ) ) return false;
 
-    return covered;
+    if ( p->get_color() == principalColor ){
+        ++numPrincipalColor;
+        return true;
+    }
+    ++numOtherColor;
+    return false;
 }
 
 bool Model::covers( const CoveredPoint *p ) const {
-    vector<ClosedSpace*>::const_iterator nsit;
-
-    bool is_covered = false;
-    for ( nsit = spaces.begin(); nsit != spaces.end(); ++nsit ) {
-        if ( (*nsit)->in_closure( p->get_data_point() ) ){
-            is_covered = true;
-            break;
-        }
-    }
+    return in_spaces( p->get_data_point() );
+}
 
-    return is_covered;
+void Model::covers( const PointColumns &points, const size_t &begin,
+                    const size_t &end, char *covered ) const {
+    in_spaces( points, 0, begin, end, covered );
 }
 
 void Model::clear_checked_points(){
+    frozen = false;
     numPrincipalColor = 0.0;
     numOtherColor = 0.0;
+    coveredPoints.clear();
+    numCheckedSpaces = 0;
+    numCheckedPoints = 0;
+}
+
+void Model::begin_checking_points( const size_t &num_points ){
+    if ( num_points != numCheckedPoints ) {
+        clear_checked_points();
+        numCheckedPoints = num_points;
+    }
+    coveredPoints.resize( (num_points + 63)/64, 0 );
 }
 
-double Model::characteristic( const DataPoint *p ){
-    vector<ClosedSpace*>::const_iterator nsit;
+void Model::check_points( const PointColumns &points, const size_t &begin,
+                          const size_t &end, char *newly_covered ){
+    size_t num_points = end - begin;
+    for ( size_t k = 0; k < num_points; ++k ) {
+        newly_covered[k] = 0;
+    }
 
-    double characteristic = 0.0;
-    for ( nsit = spaces.begin(); nsit != spaces.end(); ++nsit ) {
-        if ( (*nsit)->in_closure(p) ){
-            characteristic = 1.0;
-            break;
+    if ( num_points == 0 || numCheckedSpaces >= num_spaces() ) return;
+
+    // Only runs of points whose words of the covered bitset still have
+    // uncovered points among [begin,end) are tested; the points of words
+    // already fully covered are skipped
+    vector<char> inside( num_points, 0 );
+    size_t run_begin = end;
+    for ( size_t word_begin = begin; word_begin < end; ) {
+        size_t word_end = (word_begin/64 + 1)*64;
+        if ( word_end > end ) word_end = end;
+
+        // The bits of the points [word_begin,word_end) within their word
+        size_t count = word_end - word_begin;
+        uint64_t mask = ~static_cast<uint64_t>(0);
+        if ( count < 64 ) {
+            mask = ( ( static_cast<uint64_t>(1) << count ) - 1 ) << 
+                                                        (word_begin % 64);
         }
+        bool full = ( coveredPoints[word_begin/64] & mask ) == mask;
+
+        if ( !full && run_begin == end ) run_begin = word_begin;
+        if ( run_begin != end && ( full || word_end == end ) ) {
+            size_t run_end = full ? word_begin : word_end;
+            in_spaces( points, numCheckedSpaces, run_begin, run_end, 
+                       &inside[run_begin - begin] );
+            run_begin = end;
+        }
+        word_begin = word_end;
     }
 
+    for ( size_t k = 0; k < num_points; ++k ) {
+        if ( !inside[k] ) continue;
+        size_t index = begin + k;
+        uint64_t bit = static_cast<uint64_t>(1) << (index % 64);
+        uint64_t &word = coveredPoints[index/64];
+        if ( word & bit ) continue;
+        word |= bit;
+        newly_covered[k] = 1;
+    }
+}
+
+void Model::grow_last_space( const Orthotope &region, Random *rand,
+                             const double &frac ){
+    thicken( region, rand, frac );
+
+    if ( num_spaces() > 0 && numCheckedSpaces >= num_spaces() ) {
+        numCheckedSpaces = num_spaces() - 1;
+    }
+}
+
+void Model::commit_checked_points( const int &num_principal, 
+                                   const int &num_other ){
+    frozen = false;
+    numPrincipalColor += static_cast<double>(num_principal);
+    numOtherColor += static_cast<double>(num_other);
+    numCheckedSpaces = num_spaces();
+}
+
+double Model::characteristic( const DataPoint *p ) const {
+    return characteristic( in_spaces( p ) );
+}
+
+void Model::write( util::BinaryWriter &out ) const {
+    out.write_int( principalColor );
+    out.write_double( totalPrincipalColors );
+    out.write_double( totalOtherColors );
+    out.write_double( numPrincipalColor );
+    out.write_double( numOtherColor );
+    out.write_double( characteristic( true ) );
+    out.write_double( characteristic( false ) );
+    out.write_int( num_spaces() );
+    write_spaces( out );
+}
+
+void Model::read( util::BinaryReader &in, const NoirSpace *noirSpace ){
+    if ( num_spaces() != 0 ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                        "A model can only be read into an empty model." );
+    }
+
+    clear_checked_points();
+    principalColor = static_cast<int>( in.read_int() );
+    totalPrincipalColors = in.read_double();
+    totalOtherColors = in.read_double();
+    numPrincipalColor = in.read_double();
+    numOtherColor = in.read_double();
+    double covered_value = in.read_double();
+    double uncovered_value = in.read_double();
+
+    int64_t num_read = in.read_int();
+    if ( num_read < 0 ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                        "Invalid number of subspaces of a model." );
+    }
+    read_spaces( in, noirSpace, static_cast<size_t>(num_read) );
+
+    coveredValue = covered_value;
+    uncoveredValue = uncovered_value;
+    frozen = true;
+}
+
+void Model::freeze(){
+    coveredValue = normalized_characteristic( true );
+    uncoveredValue = normalized_characteristic( false );
+    frozen = true;
+}
+
+double Model::normalized_characteristic( const bool &is_covered ) const {
+    double characteristic = is_covered ? 1.0 : 0.0;
+
     double fracOther = numOtherColor/totalOtherColors;
     return ( (characteristic - fracOther)/
               (numPrincipalColor/totalPrincipalColors - fracOther) );
@@ -17,34 +17,37 @@
 #ifndef SDM_MODEL_H
 #define SDM_MODEL_H
 
+#include <cstddef>
+#include <cstdint>
 #include <limits>
 #include <vector>
 
 #include "sdm/covered_point.h"
 #include "noir/noir_space.h"
 #include "noir/orthotope.h"
+#include "noir/point_columns.h"
 #include "rng/random.h"
+#include "util/arena.h"
+#include "util/binary_file.h"
 
 namespace sdm {
 
 /*
- * This Model implementation consists of a union of Orthotopes.
+ * A Model consists of a union of closed subspaces. The subspaces themselves
+ * are held by a SpaceModel of the type of subspace used.
  */
 class Model {
  public:
     Model(const int &principal_color, const double &total_principal_colors,
-          const double &total_other_colors): spaces(),
+          const double &total_other_colors): arena(4096),
           totalPrincipalColors(total_principal_colors),
           totalOtherColors(total_other_colors),
           numPrincipalColor(0.0), numOtherColor(0.0),
-          principalColor( principal_color) {}
+          principalColor( principal_color), coveredPoints(),
+          numCheckedSpaces(0), numCheckedPoints(0), frozen(false),
+          coveredValue(0.0), uncoveredValue(0.0) {}
 
-    virtual ~Model(){
-        std::vector<noir::ClosedSpace*>::iterator hit;
-        for ( hit = spaces.begin(); hit != spaces.end(); ++hit ){
-            delete (*hit);
-        }
-    }
+    virtual ~Model() {}
 
     /*
      * Retrieves the principal color (class) for this model.
@@ -70,7 +73,7 @@ class Model {
     }
 
     int get_num_elements() const {
-        return static_cast<int>(spaces.size());
+        return static_cast<int>(num_spaces());
     }
 
     /*
@@ -91,7 +94,18 @@ class Model {
                  const double &frac ) = 0;
 
     /*
-     * Resets the registers used to track checked points.
+     * Grows the last subspace in the model's list by thickening it, keeping
+     * the record of covered points. Thickening only enlarges the subspace
+     * within the region, so points already covered remain covered and the
+     * next incremental check only tests the uncovered points against the
+     * grown subspace.
+     */
+    void grow_last_space( const noir::Orthotope &region, rng::Random *rand,
+                          const double &frac );
+
+    /*
+     * Resets the registers used to track checked points, including the
+     * record of which training points are covered.
      */
     void clear_checked_points();
 
@@ -104,11 +118,61 @@ class Model {
      */
     bool check_point( const CoveredPoint *p );
 
+    /*
+     * Prepares the incremental checking of num_points training points.
+     *
+     * The model remembers which training points are covered by the subspaces
+     * it has already checked. A point once covered stays covered as long as
+     * the subspaces only grow in number, so subsequent checks only need to
+     * test the points not yet covered against the subspaces added since.
+     * If the number of training points changed, everything is rechecked.
+     */
+    void begin_checking_points( const size_t &num_points );
+
+    /*
+     * Incrementally checks the training points [begin,end), given by their
+     * columns. Points are only tested against the subspaces added since the
+     * previous check, and points in runs of 64, as kept by the covered
+     * bitset, which are all known to be covered are not tested again. Other
+     * points already covered may be tested, but are not counted again.
+     * newly_covered[k] is set if point begin+k was not covered before but
+     * is covered now.
+     *
+     * The registers are not touched; the caller counts the newly covered
+     * points and adds them with commit_checked_points. Blocks of points
+     * which start at multiples of 64 may therefore be checked concurrently.
+     */
+    void check_points( const noir::PointColumns &points, const size_t &begin,
+                       const size_t &end, char *newly_covered );
+
+    /*
+     * Checks whether or not the index-th training point was found to be
+     * covered by the most recent incremental check.
+     */
+    bool is_covered_point( const size_t &index ) const {
+        return (coveredPoints[index/64] >> (index % 64)) & 1;
+    }
+
+    /*
+     * Finishes an incremental check by adding the numbers of newly covered
+     * points to the registers used to track checked points.
+     */
+    void commit_checked_points( const int &num_principal, 
+                                const int &num_other );
+
     /*
      * Checks whether or not the specified point is covered by this model.
      * It returns true if the point is covered by this model.
      */
     bool covers( const CoveredPoint *p ) const;
+
+    /*
+     * Determines, for each of the points [begin,end) of the specified
+     * columns, whether or not it is covered by this model. The answer for
+     * point begin+k is stored in covered[k].
+     */
+    void covers( const noir::PointColumns &points, const size_t &begin,
+                 const size_t &end, char *covered ) const;
     
     /*
      * Evaluates the normalized characteristic function for the specified
@@ -119,10 +183,85 @@ class Model {
      *        g_frac is the green fraction for this model
      *        r_frac is the red fraction for this model
      */
-    double characteristic( const DataPoint *p);
+    double characteristic( const DataPoint *p) const;
+
+    /*
+     * Evaluates the normalized characteristic function for a point which
+     * is, or is not, covered by this model.
+     */
+    double characteristic( const bool &is_covered ) const {
+        if ( frozen ) return is_covered ? coveredValue : uncoveredValue;
+        return normalized_characteristic( is_covered );
+    }
+
+    /*
+     * Freezes the registers of this model, once it has been learned, and
+     * caches the two values of its characteristic function, so that
+     * evaluating it is a mere choice between them. Checking points again
+     * thaws the model.
+     */
+    void freeze();
+
+    /*
+     * Checks whether or not the model is frozen.
+     */
+    bool is_frozen() const {
+        return frozen;
+    }
+
+    /*
+     * Writes this model: its principal color, the registers on which its
+     * characteristic function depends, the two values of the function, and
+     * its subspaces. ModelView reads the records of orthotope models in
+     * place, so their layout must be kept in step with it.
+     */
+    void write( util::BinaryWriter &out ) const;
+
+    /*
+     * Reads a model written by write into this model, which must not have
+     * any subspaces yet. The subspaces are created in the specified space.
+     * The model read is frozen with the values of its characteristic
+     * function as written.
+     */
+    void read( util::BinaryReader &in, const noir::NoirSpace *noirSpace );
 
  protected:
-    std::vector<noir::ClosedSpace*> spaces;
+    // Holds the storage of all subspaces of this model
+    util::Arena arena;
+
+    /*
+     * Retrieves the number of subspaces of this model.
+     */
+    virtual size_t num_spaces() const = 0;
+
+    /*
+     * Determines whether or not the specified point is contained within
+     * any of the subspaces of this model.
+     */
+    virtual bool in_spaces( const noir::Point *point ) const = 0;
+
+    /*
+     * Determines, for each of the points [begin,end) of the specified
+     * columns, whether or not it is contained within any of the subspaces
+     * from first_space on. The answer for point begin+k is stored in
+     * inside[k].
+     */
+    virtual void in_spaces( const noir::PointColumns &points,
+                            const size_t &first_space, const size_t &begin,
+                            const size_t &end, char *inside ) const = 0;
+
+    /*
+     * Writes the subspaces of this model.
+     */
+    virtual void write_spaces( util::BinaryWriter &out ) const = 0;
+
+    /*
+     * Reads the specified number of subspaces, creating them in the
+     * specified space, and adds them to this model.
+     */
+    virtual void read_spaces( util::BinaryReader &in, 
+                              const noir::NoirSpace *noirSpace,
+                              const size_t &num_spaces ) = 0;
 
  private:
     double totalPrincipalColors;
@@ -130,6 +269,17 @@ class Model {
     double numPrincipalColor;
     double numOtherColor;
     int    principalColor;
+    std::vector<uint64_t> coveredPoints;
+    size_t numCheckedSpaces;
+    size_t numCheckedPoints;
+
+    // The values of the characteristic function of a frozen model for a
+    // covered and an uncovered point
+    bool frozen;
+    double coveredValue;
+    double uncoveredValue;
+
+    double normalized_characteristic( const bool &is_covered ) const;
 
     Model(const Model&) = delete;
     Model& operator=(const Model&) = delete;
@@ -0,0 +1,120 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "sdm/model_view.h"
+
+#include <climits>
+
+#include "noir/orthotope.h"
+#include "util/invalid_input_error.h"
+
+namespace sdm {
+
+using noir::NoirSpace;
+using noir::Orthotope;
+using noir::Point;
+using noir::PointColumns;
+
+ModelView::ModelView( const NoirSpace *noir_space, const char *record ) :
+                            noirSpace(noir_space),
+                            header(reinterpret_cast<const int64_t*>(record)),
+                            recordSize(HEADER_SIZE*sizeof(int64_t)) {
+    size_t num_spaces = get_num_spaces();
+    for ( size_t s = 0; s < num_spaces; ++s ) {
+        Orthotope space( noirSpace, record + recordSize );
+        recordSize += space.get_record_size();
+    }
+}
+
+size_t ModelView::check_record( const NoirSpace *noirSpace, 
+                                 const char *record, 
+                                 const size_t &available ) {
+    const size_t header_size = HEADER_SIZE*sizeof(int64_t);
+    if ( available < header_size ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                        "A model record ends before its subspaces." );
+    }
+
+    const int64_t *values = reinterpret_cast<const int64_t*>( record );
+    if ( values[NUM_SPACES] < 0 ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                        "Invalid number of subspaces of a model." );
+    }
+
+    // Each orthotope record starts with the number of words of its nominal
+    // masks, by which its size is known
+    size_t size = header_size;
+    for ( int64_t s = 0; s < values[NUM_SPACES]; ++s ) {
+        if ( available - size < sizeof(int64_t) ) {
+            throw util::InvalidInputError( __FILE__, __LINE__,
+                        "A model record ends within its subspaces." );
+        }
+        int64_t words = *reinterpret_cast<const int64_t*>( record + size );
+        if ( words < 1 || words > INT_MAX/64 ) {
+            throw util::InvalidInputError( __FILE__, __LINE__,
+                        "Invalid number of nominal words of an orthotope." );
+        }
+
+        Orthotope space( noirSpace, record + size );
+        if ( available - size < space.get_record_size() ) {
+            throw util::InvalidInputError( __FILE__, __LINE__,
+                        "A model record ends within its subspaces." );
+        }
+        size += space.get_record_size();
+    }
+    return size;
+}
+
+bool ModelView::covers( const Point *point ) const {
+    const char *record = reinterpret_cast<const char*>( header + HEADER_SIZE );
+    size_t num_spaces = get_num_spaces();
+    for ( size_t s = 0; s < num_spaces; ++s ) {
+        Orthotope space( noirSpace, record );
+        if ( space.in_closure( point ) ) return true;
+        record += space.get_record_size();
+    }
+    return false;
+}
+
+void ModelView::covers( const PointColumns &points, const size_t &begin,
+                        const size_t &end, char *covered ) const {
+    for ( size_t k = 0; k < end - begin; ++k ) {
+        covered[k] = 0;
+    }
+
+    // The points are taken in chunks small enough for the answers of an
+    // orthotope to stay on the stack
+    char in_space[CHUNK];
+    size_t num_spaces = get_num_spaces();
+    for ( size_t first = begin; first < end; first += CHUNK ) {
+        size_t last = first + CHUNK;
+        if ( last > end ) last = end;
+        char *chunk_covered = covered + (first - begin);
+
+        const char *record = 
+                    reinterpret_cast<const char*>( header + HEADER_SIZE );
+        for ( size_t s = 0; s < num_spaces; ++s ) {
+            Orthotope space( noirSpace, record );
+            space.in_closure( points, first, last, in_space );
+            for ( size_t k = 0; k < last - first; ++k ) {
+                chunk_covered[k] |= in_space[k];
+            }
+            record += space.get_record_size();
+        }
+    }
+}
+
+}   // end namespace sdm
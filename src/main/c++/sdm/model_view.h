@@ -0,0 +1,118 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef SDM_MODEL_VIEW_H
+#define SDM_MODEL_VIEW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "noir/noir_space.h"
+#include "noir/point.h"
+#include "noir/point_columns.h"
+
+namespace sdm {
+
+/*
+ * A Model View is a read-only counterpart of an orthotope model, which
+ * evaluates the model in place from the record written by Model::write,
+ * e.g. in a file mapped into memory. Nothing is copied: the orthotopes are
+ * tested over their records, whose layout is that of the storage of any
+ * orthotope, and the values of the characteristic function are those the
+ * model was frozen with.
+ */
+class ModelView {
+ public:
+    /*
+     * Creates a view of the model record starting at the specified address,
+     * which must have been checked by check_record.
+     */
+    ModelView( const noir::NoirSpace *noirSpace, const char *record );
+
+    /*
+     * Checks that the model record starting at the specified address lies
+     * within the specified number of bytes and retrieves its size.
+     */
+    static size_t check_record( const noir::NoirSpace *noirSpace,
+                                const char *record, const size_t &available );
+
+    /*
+     * Retrieves the size in bytes of the record of this model.
+     */
+    size_t get_record_size() const {
+        return recordSize;
+    }
+
+    /*
+     * Retrieves the principal color (class) for this model.
+     */
+    int get_principal_color() const {
+        return static_cast<int>( header[PRINCIPAL_COLOR] );
+    }
+
+    /*
+     * Retrieves the number of orthotopes of this model.
+     */
+    size_t get_num_spaces() const {
+        return static_cast<size_t>( header[NUM_SPACES] );
+    }
+
+    /*
+     * Evaluates the normalized characteristic function for a point which
+     * is, or is not, covered by this model.
+     */
+    double characteristic( const bool &is_covered ) const {
+        // The value is copied out of the header of 64 bit integers, rather
+        // than read through a pointer to double, which would break the
+        // strict aliasing rules
+        double value;
+        memcpy( &value, header + (is_covered ? COVERED_VALUE : 
+                                               UNCOVERED_VALUE), 
+                sizeof(value) );
+        return value;
+    }
+
+    /*
+     * Checks whether or not the specified point is covered by this model.
+     */
+    bool covers( const noir::Point *point ) const;
+
+    /*
+     * Determines, for each of the points [begin,end) of the specified
+     * columns, whether or not it is covered by this model. The answer for
+     * point begin+k is stored in covered[k].
+     */
+    void covers( const noir::PointColumns &points, const size_t &begin,
+                 const size_t &end, char *covered ) const;
+
+ private:
+    // The positions of the values of a model record ahead of its orthotopes
+    enum Header { PRINCIPAL_COLOR, TOTAL_PRINCIPAL_COLORS, TOTAL_OTHER_COLORS,
+                  NUM_PRINCIPAL_COLOR, NUM_OTHER_COLOR, COVERED_VALUE,
+                  UNCOVERED_VALUE, NUM_SPACES, HEADER_SIZE };
+
+    // The number of points tested against an orthotope at a time
+    static const size_t CHUNK = 256;
+
+    const noir::NoirSpace *noirSpace;
+    const int64_t *header;
+    size_t recordSize;
+};
+
+}   // end namespace sdm
+
+#endif   // SDM_MODEL_VIEW_H
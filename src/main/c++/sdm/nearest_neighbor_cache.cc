@@ -0,0 +1,192 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "sdm/nearest_neighbor_cache.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "noir/noir_space.h"
+#include "noir/point.h"
+#include "noir/point_columns.h"
+#include "noir/vp_tree.h"
+
+namespace sdm {
+
+using std::vector;
+using noir::NoirSpace;
+using noir::Norm;
+using noir::Point;
+using noir::PointColumns;
+using noir::VPTree;
+
+namespace {
+
+// The number of points whose neighbours are found by a single task
+const size_t POINTS_PER_TASK = 256;
+
+// The number of points whose distances to a point are found at a time
+const size_t DISTANCE_BLOCK = 4096;
+
+struct Neighbor {
+    double dist;
+    int number;
+
+    bool operator<( const Neighbor &that ) const {
+        return dist < that.dist || 
+               ( dist == that.dist && number < that.number );
+    }
+};
+
+// The distances found by a thread, kept from task to task, and only
+// allocated by threads comparing points with missing coordinates
+thread_local vector<double> distances;
+
+/*
+ * Offers a candidate to the k nearest neighbours found so far, which are
+ * kept in a heap with the farthest on top.
+ */
+inline void offer( vector<Neighbor> &nearest, const size_t &k, 
+                   const Neighbor &candidate ) {
+    if ( nearest.size() < k ) {
+        nearest.push_back( candidate );
+        std::push_heap( nearest.begin(), nearest.end() );
+    } else if ( candidate < nearest.front() ) {
+        std::pop_heap( nearest.begin(), nearest.end() );
+        nearest.back() = candidate;
+        std::push_heap( nearest.begin(), nearest.end() );
+    }
+}
+
+/*
+ * Offers the points [0,num_columns) of the specified columns, but skip,
+ * as neighbours of the specified point. The m-th point is numbered
+ * numbers[m], or m if no numbers are given.
+ */
+void offer_columns( const Norm &norm, const Point *point, 
+                    const PointColumns &columns, const size_t &num_columns,
+                    const int *numbers, const size_t &skip,
+                    vector<Neighbor> &nearest, const size_t &k ) {
+    if ( distances.size() < DISTANCE_BLOCK ) {
+        distances.resize( DISTANCE_BLOCK );
+    }
+    double *dist = &distances[0];
+
+    for ( size_t first = 0; first < num_columns; first += DISTANCE_BLOCK ) {
+        size_t last = std::min( first + DISTANCE_BLOCK, num_columns );
+        norm( point, columns, first, last, dist );
+        for ( size_t m = first; m < last; ++m ) {
+            if ( m == skip ) continue;
+            int number = numbers != 0 ? numbers[m] : static_cast<int>(m);
+            Neighbor candidate = { dist[m - first], number };
+            offer( nearest, k, candidate );
+        }
+    }
+}
+
+}  // namespace
+
+NearestNeighborCache::NearestNeighborCache( const vector<DataStore*> &folds,
+                                            const int &color, 
+                                            const int &num_neighbors,
+                                            util::ThreadPool *thread_pool ) :
+                            color(color), 
+                            numNeighbors( std::max( num_neighbors, 1 ) ),
+                            numbers(), neighbors() {
+    vector<const Point*> points;
+    for ( size_t f = 0; f < folds.size(); ++f ) {
+        DataStore::const_iterator pit;
+        for ( pit = folds[f]->begin(); pit != folds[f]->end(); ++pit ) {
+            if ( (*pit)->get_color() != color ) continue;
+            numbers[*pit] = static_cast<int>(points.size());
+            points.push_back( *pit );
+        }
+    }
+
+    size_t num_points = points.size();
+    neighbors.assign( num_points*numNeighbors, -1 );
+    if ( num_points == 0 ) return;
+
+    // As in TrainingData::find_nn, complete points are searched with a
+    // vantage point tree, and points with missing coordinates are compared
+    // with every point using the batched form of the norm.
+    const NoirSpace *noirSpace = points[0]->noirSpace;
+    const Norm norm = noirSpace->norm;
+    vector<const Point*> tree_points;
+    vector<int> tree_index;
+    vector<int> tree_position( num_points, -1 );
+    vector<int> incomplete_index;
+    PointColumns all_columns( noirSpace );
+    PointColumns incomplete_columns( noirSpace );
+    all_columns.reserve( num_points );
+    for ( size_t p = 0; p < num_points; ++p ){
+        all_columns.add( points[p] );
+        if ( VPTree::is_complete( points[p] ) ) {
+            tree_position[p] = static_cast<int>(tree_points.size());
+            tree_points.push_back( points[p] );
+            tree_index.push_back( static_cast<int>(p) );
+        } else {
+            incomplete_columns.add( points[p] );
+            incomplete_index.push_back( static_cast<int>(p) );
+        }
+    }
+
+    VPTree tree( tree_points );
+    const size_t k = static_cast<size_t>(numNeighbors);
+
+    // Each task writes the neighbours of its own points only. Only the k
+    // nearest candidates are kept, and distances are found in blocks, so
+    // the memory used does not grow with the number of points.
+    const size_t num_incomplete = incomplete_index.size();
+    auto find = [&]( size_t begin, size_t end ){
+        vector<int> found;
+        vector<double> found_dist;
+        vector<Neighbor> nearest;
+        nearest.reserve( k );
+        for ( size_t i = begin; i < end; ++i ){
+            nearest.clear();
+            if ( tree_position[i] >= 0 ) {
+                tree.nearest( points[i], tree_position[i], k, found, 
+                              found_dist );
+                for ( size_t m = 0; m < found.size(); ++m ){
+                    Neighbor neighbor = { found_dist[m], tree_index[found[m]] };
+                    offer( nearest, k, neighbor );
+                }
+                if ( num_incomplete > 0 ) {
+                    offer_columns( norm, points[i], incomplete_columns, 
+                                   num_incomplete, &incomplete_index[0], 
+                                   num_incomplete, nearest, k );
+                }
+            } else {
+                offer_columns( norm, points[i], all_columns, num_points, 0,
+                               i, nearest, k );
+            }
+
+            std::sort_heap( nearest.begin(), nearest.end() );
+            for ( size_t m = 0; m < nearest.size(); ++m ){
+                neighbors[i*k + m] = nearest[m].number;
+            }
+        }
+    };
+
+    if ( thread_pool == 0 ) {
+        find( 0, num_points );
+    } else {
+        thread_pool->parallel_for( 0, num_points, POINTS_PER_TASK, find );
+    }
+}
+
+}  // namespace sdm
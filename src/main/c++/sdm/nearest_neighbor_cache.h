@@ -0,0 +1,104 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef SDM_NEAREST_NEIGHBOR_CACHE_H
+#define SDM_NEAREST_NEIGHBOR_CACHE_H
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "sdm/data_point.h"
+#include "sdm/data_store.h"
+#include "util/thread_pool.h"
+
+namespace sdm {
+
+/*
+ * The nearest neighbours of the training points of one color, found once
+ * for all folds of a cross-validation analysis.
+ *
+ * The points are numbered in the order of the folds, so the points a fold
+ * trains on keep their relative order. The nearest neighbour of a point
+ * within those points is then the first of its cached neighbours which is
+ * not held out; only if all of them are held out must it be searched for.
+ */
+class NearestNeighborCache {
+ public:
+    /*
+     * Finds, for every point of the specified color in the specified folds,
+     * its num_neighbors nearest neighbours of the same color. The work is
+     * shared out over the specified pool of threads, if any.
+     */
+    NearestNeighborCache( const std::vector<DataStore*> &folds, 
+                          const int &color, const int &num_neighbors, 
+                          util::ThreadPool *thread_pool = 0 );
+
+    virtual ~NearestNeighborCache() {}
+
+    /*
+     * Retrieve the color of the cached points.
+     */
+    int get_color() const {
+        return color;
+    }
+
+    /*
+     * Retrieve the number of neighbours cached for each point.
+     */
+    int get_num_neighbors() const {
+        return numNeighbors;
+    }
+
+    /*
+     * Retrieve the number of cached points.
+     */
+    size_t size() const {
+        return numbers.size();
+    }
+
+    /*
+     * Retrieve the number of the specified point, or -1 if it is not cached.
+     */
+    int find( const DataPoint *point ) const {
+        std::unordered_map<const DataPoint*, int>::const_iterator nit = 
+                                                        numbers.find( point );
+        return nit != numbers.end() ? nit->second : -1;
+    }
+
+    /*
+     * Retrieve the numbers of the neighbours of the point with the specified
+     * number, nearest first. Of several neighbours at the same distance the
+     * one with the lowest number comes first. There are get_num_neighbors
+     * entries; if the color has too few points, the list ends with a -1.
+     */
+    const int* get_neighbors( const int &number ) const {
+        return &neighbors[number*numNeighbors];
+    }
+
+ private:
+    int color;
+    int numNeighbors;
+    std::unordered_map<const DataPoint*, int> numbers;
+    std::vector<int> neighbors;
+
+    NearestNeighborCache(const NearestNeighborCache&) = delete;
+    NearestNeighborCache& operator=(const NearestNeighborCache&) = delete;
+};
+
+}   // end namespace sdm
+
+#endif   // SDM_NEAREST_NEIGHBOR_CACHE_H
@@ -19,6 +19,7 @@
 
 #include <cmath>
 #include <limits>
+#include <new>
 #include <set>
 #include <vector>
 
@@ -42,7 +43,9 @@ void OrthotopeModel::expand( const Orthotope &region, CoveredPoint *nexus,
                     const double &lp, const double &up ){
 
     const NoirSpace *noirSpace = nexus->get_noir_space();
-    Orthotope *orthotope = new Orthotope( noirSpace );
+    Orthotope *orthotope = new (arena.allocate( sizeof(Orthotope), 
+                                                alignof(Orthotope) ))
+                                Orthotope( noirSpace, &arena );
 
     double upper = 0.0;
     double lower = 0.0;
@@ -167,12 +170,11 @@ void OrthotopeModel::expand( const Orthotope &region, CoveredPoint *nexus,
         int nn_coordinate = nn_nominals[n];
         if ( coordinate == -1 || nn_coordinate == -1 ) continue;
 
-        const set<int> allowed = region.get_nominals(n);
 
         orthotope->add_nominal( n, coordinate );
         orthotope->add_nominal( n, nn_nominals[n] );
 
-        int max_allowable = static_cast<int>(allowed.size());
+        int max_allowable = region.get_num_nominals(n);
 
         for ( int nn = 0; nn < max_allowable; ++nn) {
             if ( rand->next() > up ) continue;
@@ -188,7 +190,7 @@ void OrthotopeModel::expand( const Orthotope &region, CoveredPoint *nexus,
 void OrthotopeModel::thicken(const Orthotope &region, Random *rand, 
                               const double &frac){
 
-    Orthotope *orthotope = dynamic_cast<Orthotope*>(spaces.back());
+    Orthotope *orthotope = spaces.back();
 
     double upper = 0.0;
     double lower = 0.0;
@@ -201,5 +203,10 @@ void OrthotopeModel::thicken(const Orthotope &region, Random *rand,
     }
 }
 
+Orthotope* OrthotopeModel::new_space( const NoirSpace *noirSpace ){
+    return new (arena.allocate( sizeof(Orthotope), alignof(Orthotope) ))
+               Orthotope( noirSpace, &arena );
+}
+
 
 }  // namespace sdm
@@ -22,6 +22,7 @@
 
 #include "sdm/covered_point.h"
 #include "sdm/model.h"
+#include "sdm/space_model.h"
 #include "noir/noir_space.h"
 #include "noir/orthotope.h"
 #include "rng/random.h"
@@ -31,13 +32,14 @@ namespace sdm {
 /*
  * This Model implementation consists of a union of Orthotopes.
  */
-class OrthotopeModel : public Model {
+class OrthotopeModel : public SpaceModel<noir::Orthotope> {
  public:
     OrthotopeModel(const int &principal_color, 
                    const double &total_principal_colors,
                    const double &total_other_colors):
-                   Model( principal_color, total_principal_colors, 
-                          total_other_colors ) {}
+                   SpaceModel<noir::Orthotope>( principal_color,
+                                                total_principal_colors, 
+                                                total_other_colors ) {}
 
     virtual ~OrthotopeModel() {}
 
@@ -54,6 +56,9 @@ class OrthotopeModel : public Model {
      */
     void thicken( const noir::Orthotope &region, rng::Random *rand,
                  const double &frac );
+
+ protected:
+    noir::Orthotope* new_space( const noir::NoirSpace *noirSpace );
 };
 
 /*
@@ -16,15 +16,20 @@
 
 #include "sdm/sdmachine.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <limits>
 #include <string>
 #include <vector>
 
-#include <pthread.h>
 #include <stdio.h>
 
 #include "noir/orthotope.h"
+#include "noir/point_columns.h"
+#include "sdm/compiled_discriminator.h"
 #include "sdm/discriminator.h"
+#include "sdm/discriminator_view.h"
 #include "sdm/data_point.h"
 #include "sdm/model.h"
 #include "sdm/ball_model.h"
@@ -34,9 +39,12 @@
 #include "rng/random_factory.h"
 #include "rng/ranmar.h"
 #include "stat/roc.h"
+#include "util/binary_file.h"
 #include "util/functions.h"
+#include "util/mapped_file.h"
 #include "util/properties.h"
 #include "util/invalid_input_error.h"
+#include "util/thread_pool.h"
 
 
 namespace sdm {
@@ -44,27 +52,45 @@ namespace sdm {
 using std::string;
 using std::vector;
 
+using noir::NoirSpace;
 using noir::Orthotope;
+using noir::PointColumns;
 using rng::Random;
 using rng::RandomFactory;
 using stat::ROC;
+using util::BinaryReader;
+using util::BinaryWriter;
+using util::MappedFile;
 using util::to_numeric;
+using util::to_string;
 using util::Properties;
+using util::ThreadPool;
+
+// The number of points scored by a single task in the testing stage
+static const size_t POINTS_PER_TASK = 1024;
+
+// The start of a file of saved discriminators, the version of its format
+// and a value by which the byte order of the file is checked
+static const char FILE_MAGIC[8] = { 'S', 'T', 'O', 'C', 'H', 'S', 'D', 'M' };
+static const int64_t FILE_VERSION = 2;
+static const int64_t FILE_BYTE_ORDER = 0x0102030405060708LL;
 
 SDMachine::~SDMachine() {
     delete uniform;
 
-    vector<Discriminator*>::const_iterator dit;
-    for (dit = discriminators.begin(); dit != discriminators.end(); ++dit) {
-        delete *dit;
-    }
-    discriminators.clear();
+    delete_discriminators( discriminators );
+    delete_fold_randoms();
+
+    delete threadPool;
 
     vector<ROC*>::const_iterator rit;
     for (rit = learning_results.begin(); rit != learning_results.end(); ++rit) {
         delete *rit;
     }
     learning_results.clear();
+
+    delete_mapped_discriminators();
+    delete modelSpace;
 }
 
 
@@ -104,6 +130,19 @@ void SDMachine::init( Properties &parameters ) {
     set_value( "SDM::Learning::MaximumNumberOfSubspaces", numAttempts );
     set_value( "SDM::Learning::EnrichmentLevel", enrichmentLevel );
 
+    // The number of threads is optional, by default all cores are used
+    if ( !sdmParameters->get_property( "SDM::Threads" ).empty() ) {
+        set_value( "SDM::Threads", numThreads );
+    }
+    threadPool = new ThreadPool( numThreads );
+    numThreads = threadPool->size();
+
+    // Speculative generation of models is optional
+    if ( !sdmParameters->get_property( 
+                        "SDM::Learning::SpeculativeBatchSize" ).empty() ) {
+        set_value( "SDM::Learning::SpeculativeBatchSize", batchSize );
+    }
+
     string subspaceTypes;
     set_parameter( "SDM::Model::SubspaceTypes", subspaceTypes );
 
@@ -128,6 +167,81 @@ void SDMachine::init( Properties &parameters ) {
                       "Unknown learning algorithm: " + learning_algorithms);
     }
 
+    // Concurrent cross-validation folds are optional, by default the folds
+    // are learned one after the other
+    string concurrent_folds =
+                sdmParameters->get_property( "SDM::Learning::ConcurrentFolds" );
+
+    if ( concurrent_folds.empty() || concurrent_folds.compare( "false" ) == 0 ){
+        concurrentFolds = false;
+    } else if ( concurrent_folds.compare( "true" ) == 0 ){
+        concurrentFolds = true;
+    } else {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                "Unknown value for concurrent folds: " + concurrent_folds);
+    }
+
+    // The nearest neighbour search is optional, by default an exact search
+    // suited to the data is chosen
+    string nn_search =
+                sdmParameters->get_property( "SDM::Learning::NearestNeighbor" );
+
+    if ( nn_search.empty() || nn_search.compare( "Automatic" ) == 0 ){
+        nnSearch = NearestNeighborSearch::Automatic;
+    } else if ( nn_search.compare( "Tree" ) == 0 ){
+        nnSearch = NearestNeighborSearch::Tree;
+    } else if ( nn_search.compare( "Blocked" ) == 0 ){
+        nnSearch = NearestNeighborSearch::Blocked;
+    } else if ( nn_search.compare( "Approximate" ) == 0 ){
+        nnSearch = NearestNeighborSearch::Approximate;
+    } else {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                "Unknown nearest neighbor search: " + nn_search);
+    }
+
+    // Compiled scoring is optional, by default the models are tested one
+    // by one
+    string compiled =
+                sdmParameters->get_property( "SDM::Scoring::Compiled" );
+
+    if ( compiled.empty() || compiled.compare( "false" ) == 0 ){
+        compiledScoring = false;
+    } else if ( compiled.compare( "true" ) == 0 ){
+        compiledScoring = true;
+    } else {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                "Unknown value for compiled scoring: " + compiled);
+    }
+
+    if ( compiledScoring && modelTypes != ModelTypes::Orthotope ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                "Compiled scoring requires Orthotopes as subspace types.");
+    }
+
+    // The memory of compiled discriminators is optional, by default 256 MB
+    if ( !sdmParameters->get_property( 
+                        "SDM::Scoring::CompiledMemory" ).empty() ) {
+        set_value( "SDM::Scoring::CompiledMemory", compiledMemory );
+    }
+
+    // Mapped scoring is optional, by default loaded discriminators are
+    // read into memory
+    string mapped =
+                sdmParameters->get_property( "SDM::Scoring::Mapped" );
+
+    if ( mapped.empty() || mapped.compare( "false" ) == 0 ){
+        mappedScoring = false;
+    } else if ( mapped.compare( "true" ) == 0 ){
+        mappedScoring = true;
+    } else {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                "Unknown value for mapped scoring: " + mapped);
+    }
+
+    if ( mappedScoring && compiledScoring ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                "Mapped scoring cannot be combined with compiled scoring.");
+    }
 
 }
 
@@ -141,55 +255,23 @@ void SDMachine::learn( DataManager &dataManager ) {
 }
 
 
-/*
- This struct and the following function are just hacks to speed-up the learning
- processes.  This needs to be redone to create a proper multi-threaded
- program.
-*/
-struct thread_data {
-    SDMachine *sdm;
-    Discriminator *dis;
-    DataManager *dm;
-    DataStore *dataStore;
-    int dis_id;
-    int *fold;
-};
-
-extern "C" void* prepare_discriminators( void *arg ) {
-    thread_data* td = (thread_data*) arg;
-    td->sdm->ready_discriminator( td->dis, *(td->dm), *(td->fold) );
-    return NULL;
-}
-
-
 void SDMachine::simple_learning( DataManager &dataManager ) {
 
     dataManager.partition_training_data( 1, uniform );
 
-    create_discriminators( dataManager );
+    create_fold_randoms( dataManager.get_num_colors(), 1 );
 
-    int one = 1;
-    pthread_t *tid = new pthread_t[discriminators.size()];
-    thread_data *td = new thread_data[discriminators.size()];
-    for ( size_t d = 0; d < discriminators.size(); d++ ) {
-            td[d].sdm = this;
-            td[d].dis = discriminators[d];
-            td[d].dm = &dataManager;
-            td[d].fold = &one;
-            pthread_create( &tid[d], NULL, 
-                            prepare_discriminators, &td[d] );
-            //prepare_discriminators( td );
-    }
+    create_discriminators( dataManager, discriminators );
+    set_fold_randoms( discriminators, 0 );
 
-    for ( size_t d = 0; d < discriminators.size(); d++ ) {
-        pthread_join( tid[d], NULL );
-    }
+    train_discriminators( discriminators, dataManager, 1 );
 
-    delete[] tid;
-    delete[] td;
+    ROC *result = test( discriminators, *(dataManager.get_test_data()) );
 
-    ROC *result = test( *(dataManager.get_test_data()) );
+    report( result );
+}
 
+void SDMachine::report( ROC *result ) {
     fprintf(stdout,"\n%s%.4f\n%s%.4f\n%s%.4f\n%s%.4f\n\n",
                        "accuracy: ",    result->accuracy(),
                        "error rate: ",  result->error_rate(),
@@ -203,34 +285,21 @@ void SDMachine::folded_learning( DataManager &dataManager ) {
 
     dataManager.partition_training_data( numFolds, uniform );
 
-    clear_learning_results();
-
-    //create discriminators
-    create_discriminators( dataManager );
-
-    pthread_t *tid = new pthread_t[discriminators.size()];
-    thread_data *td = new thread_data[discriminators.size()];
-    for ( int f = 0; f < numFolds; f++ ) {
-        for ( size_t d = 0; d < discriminators.size(); d++ ) {
-            td[d].sdm = this;
-            td[d].dis = discriminators[d];
-            td[d].dm = &dataManager;
-            td[d].fold = &f;
-            pthread_create( &tid[d], NULL, 
-                            prepare_discriminators, &td[d] );
-        }
-        for ( size_t d = 0; d < discriminators.size(); d++ ) {
-            pthread_join( tid[d], NULL );
-        }
+    // The folds share the exact nearest neighbours, found once. Enough
+    // neighbours are kept that all of them are held out together for fewer
+    // than one in a million points.
+    if ( numFolds > 1 && nnSearch != NearestNeighborSearch::Approximate ) {
+        int num_neighbors = static_cast<int>( 
+                                ceil( log( 1.0e6 )/log( numFolds ) ) );
+        dataManager.build_nn_caches( num_neighbors, threadPool );
+    }
 
-        ROC *result = test( *(dataManager.get_partition(f)) );
-        learning_results.push_back( result );
+    clear_learning_results();
 
-        fprintf(stdout,"\n%s%.4f\n%s%.4f\n%s%.4f\n%s%.4f\n\n",
-                       "accuracy: ",    result->accuracy(),
-                       "error rate: ",  result->error_rate(),
-                       "sensitivity: ", result->sensitivity(),
-                       "specificity: ", result->specificity() );
+    if ( concurrentFolds ) {
+        learn_folds_concurrently( dataManager );
+    } else {
+        learn_folds_serially( dataManager );
     }
 
     double avg_error_rate = 0.0;
@@ -253,23 +322,145 @@ void SDMachine::folded_learning( DataManager &dataManager ) {
                    "avg. error rate: ",  avg_error_rate,
                    "avg. sensitivity: ", avg_sensitivity,
                    "avg. specificity: ", avg_specificity );
+}
+
+/*
+ * The random number generators of every fold are created in fold order
+ * before any learning starts, and handed to the discriminators that learn
+ * the fold. The results of a fold are then the same whether the folds are
+ * learned one after the other or all at the same time, and do not depend on
+ * the number of threads or the order in which the folds are executed.
+ */
+void SDMachine::create_fold_randoms( const int &num_colors, 
+                                     const int &num_folds ) {
+    delete_fold_randoms();
+
+    RandomFactory *prf = RandomFactory::get_instance();
+
+    foldRandoms.resize( num_folds );
+    for ( int f = 0; f < num_folds; f++ ) {
+        foldRandoms[f].resize( num_colors );
+        for ( int c = 0; c < num_colors; c++ ) {
+            foldRandoms[f][c].push_back( prf->get_rng() );
+            if ( batchSize > 1 ) {
+                for ( int b = 0; b < batchSize; b++ ) {
+                    foldRandoms[f][c].push_back( prf->get_rng() );
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Sets the random number generators of the specified fold on the specified
+ * discriminators, one for each color. The discriminators take ownership of
+ * the random streams, the generator of each discriminator is kept until
+ * the next learning.
+ */
+void SDMachine::set_fold_randoms( vector<Discriminator*> &dis, 
+                                  const int &fold ) {
+    for ( size_t d = 0; d < dis.size(); d++ ) {
+        vector<Random*> &randoms = foldRandoms[fold][d];
+        dis[d]->set_random( randoms[0] );
+        if ( randoms.size() > 1 ) {
+            dis[d]->set_random_streams( 
+                        vector<Random*>( randoms.begin() + 1, randoms.end() ) );
+            randoms.resize( 1 );
+        }
+    }
+}
+
+void SDMachine::delete_fold_randoms() {
+    for ( size_t f = 0; f < foldRandoms.size(); f++ ) {
+        for ( size_t c = 0; c < foldRandoms[f].size(); c++ ) {
+            vector<Random*>::const_iterator rit;
+            for ( rit = foldRandoms[f][c].begin(); 
+                  rit != foldRandoms[f][c].end(); ++rit ) {
+                delete *rit;
+            }
+        }
+    }
+    foldRandoms.clear();
+}
+
+/*
+ * The same discriminators learn all folds, so the covered points of their
+ * training data are created once and reused for every fold.
+ */
+void SDMachine::learn_folds_serially( DataManager &dataManager ) {
+
+    create_fold_randoms( dataManager.get_num_colors(), numFolds );
+
+    delete_discriminators( discriminators );
+    create_discriminators( dataManager, discriminators );
 
-    delete[] tid;
-    delete[] td;
+    for ( int f = 0; f < numFolds; f++ ) {
+        set_fold_randoms( discriminators, f );
+        train_discriminators( discriminators, dataManager, f );
+
+        ROC *result = test( discriminators, *(dataManager.get_partition(f)) );
+        learning_results.push_back( result );
+
+        report( result );
+    }
 }
 
+/*
+ * Every worker gets its own set of discriminators, with which it learns
+ * every num_workers-th fold. The discriminators which learned the last
+ * fold are kept, as in the serial case.
+ */
+void SDMachine::learn_folds_concurrently( DataManager &dataManager ) {
 
-void SDMachine::create_discriminators(DataManager &dataManager) {
+    create_fold_randoms( dataManager.get_num_colors(), numFolds );
+
+    const int num_workers = std::max( 1, std::min( numThreads, numFolds ) );
+    vector<vector<Discriminator*> > worker_dis( num_workers );
+    for ( int w = 0; w < num_workers; w++ ) {
+        create_discriminators( dataManager, worker_dis[w] );
+    }
+
+    vector<ROC*> results( numFolds, static_cast<ROC*>(0) );
+
+    ThreadPool::TaskGroup folds;
+    for ( int w = 0; w < num_workers; w++ ) {
+        vector<Discriminator*> *dis = &worker_dis[w];
+        threadPool->submit( folds, [this, w, num_workers, dis, &results, 
+                                    &dataManager] () {
+            for ( int f = w; f < numFolds; f += num_workers ) {
+                set_fold_randoms( *dis, f );
+                train_discriminators( *dis, dataManager, f );
+                results[f] = test( *dis, *(dataManager.get_partition(f)) );
+            }
+        });
+    }
+    threadPool->wait( folds );
+
+    for ( int f = 0; f < numFolds; f++ ) {
+        learning_results.push_back( results[f] );
+        report( results[f] );
+    }
+
+    const int last = (numFolds - 1) % num_workers;
+    for ( int w = 0; w < num_workers; w++ ) {
+        if ( w != last ) delete_discriminators( worker_dis[w] );
+    }
+    delete_discriminators( discriminators );
+    discriminators.swap( worker_dis[last] );
+}
+
+void SDMachine::create_discriminators( DataManager &dataManager,
+                                       vector<Discriminator*> &created ) {
 
     const int num_colors = dataManager.get_num_colors();
     const Orthotope *enclosure = dataManager.get_enclosure();
 
-    RandomFactory *prf = RandomFactory::get_instance();
-
     for ( int c = 0; c < num_colors; c++ ) {
         Discriminator *dis = new Discriminator( c );
 
-        dis->set_random( prf->get_rng() );
+        dis->set_thread_pool( threadPool );
+        dis->set_nn_search( nnSearch );
+        dis->set_nn_cache( dataManager.get_nn_cache( c ) );
         dis->set_boundary( enclosure );
         dis->set_lower_fraction( lowerFrac );
         dis->set_upper_fraction( upperFrac );
@@ -280,18 +471,26 @@ void SDMachine::create_discriminators(DataManager &dataManager) {
             dis->set_model_factory( new OrthotopeModelFactory() );
         }
 
-        discriminators.push_back( dis );   
+        created.push_back( dis );   
     }
 }
 
+void SDMachine::delete_discriminators( vector<Discriminator*> &dis ) {
+    vector<Discriminator*>::const_iterator dit;
+    for ( dit = dis.begin(); dit != dis.end(); ++dit ) {
+        delete *dit;
+    }
+    dis.clear();
+}
+
 void SDMachine::ready_discriminator(Discriminator *dis, 
                                     DataManager &dataManager, 
                                     const int &skip_fold) {
-    dis->clear();
+    vector<DataStore*> folds;
     for ( int fold = 0; fold < numFolds; fold++ ) {
-        if ( fold == skip_fold ) continue;
-        dis->add_training_data( dataManager.get_partition( fold ) );
+        folds.push_back( dataManager.get_partition( fold ) );
     }
+    dis->select_training_data( folds, skip_fold );
     if ( learningAlgorithm == LeastCovered )
         dis->create_models_lc( numModels, numAttempts);
     else if ( learningAlgorithm == RandomPoints )
@@ -309,20 +508,18 @@ void SDMachine::ready_discriminators(DataManager &dataManager,
 
 };
 
-/*
- Again, here are some hacks to speed-up the learning. This will be redone
- after the program's basic correctness has been verified.
-*/
-
-static  double **prediction;
-extern "C" void* test_discriminators( void *arg ) {
-    thread_data* td = (thread_data*) arg;
-    unsigned num_tests = td->dataStore->size();
-    for (unsigned t = 0; t < num_tests; ++t) {
-        DataPoint *point = (*(td->dataStore))[t];
-        prediction[td->dis_id][t] = td->dis->test( point );
-    }
-    return NULL;
+void SDMachine::train_discriminators( vector<Discriminator*> &dis,
+                                      DataManager &dataManager,
+                                      const int &skip_fold ) {
+    ThreadPool::TaskGroup training;
+    for ( size_t d = 0; d < dis.size(); d++ ) {
+        Discriminator *discriminator = dis[d];
+        threadPool->submit( training, [this, discriminator, &dataManager, 
+                                       skip_fold] () {
+            ready_discriminator( discriminator, dataManager, skip_fold );
+        });
+    }
+    threadPool->wait( training );
 }
 
 void SDMachine::clear_learning_results() {
@@ -334,10 +531,127 @@ void SDMachine::clear_learning_results() {
 }
 
 
-ROC* SDMachine::test( DataStore &test_data ) {
-    vector<Discriminator*>::const_iterator dit;
-    DataStore::const_iterator pit;
+void SDMachine::predict( vector<Discriminator*> &dis, DataStore &data,
+                         vector<vector<double> > &predictions ) {
+    unsigned num_dis = dis.size();
+    size_t num_points = data.size();
+
+    predictions.assign( num_dis, vector<double>( num_points, 0.0 ) );
+    if ( num_points == 0 ) return;
+
+    // The discriminators score blocks of points taken from a columnar copy
+    // of the data, made once for all of them
+    PointColumns columns( data[0]->noirSpace );
+    for (size_t t = 0; t < num_points; ++t) {
+        columns.add( data[t] );
+    }
+    const PointColumns *points = &columns;
+
+    // If asked for, each discriminator is first compiled into a structure
+    // which looks up the models covering a point. The structures are held
+    // at the same time, so discriminators are only compiled, in order, as
+    // long as the estimated size of all structures stays within the limit;
+    // the models of the others are tested one by one.
+    vector<CompiledDiscriminator*> compiled( num_dis, 0 );
+    if ( compiledScoring ) {
+        const size_t limit = static_cast<size_t>( compiledMemory ) << 20;
+        size_t total = 0;
+        ThreadPool::TaskGroup compiling;
+        for (unsigned d = 0; d < num_dis; ++d) {
+            Discriminator *discriminator = dis[d];
+            size_t size = CompiledDiscriminator::estimate_size( 
+                                                        *discriminator );
+            if ( size > limit - total ) {
+                fprintf(stderr,"%s %d %s %.2f %s\n", 
+                        "Warning: the compiled discriminator of color",
+                        discriminator->get_principal_color(), "needs",
+                        size/1048576.0, 
+                        "MB, more than SDM::Scoring::CompiledMemory leaves; "
+                        "its models are tested one by one." );
+                continue;
+            }
+            total += size;
+            CompiledDiscriminator **target = &compiled[d];
+            threadPool->submit( compiling, [discriminator, target] () {
+                *target = new CompiledDiscriminator( *discriminator );
+            });
+        }
+        threadPool->wait( compiling );
+    }
+
+    ThreadPool::TaskGroup scoring;
+    for (unsigned d = 0; d < num_dis; ++d) {
+        Discriminator *discriminator = dis[d];
+        const CompiledDiscriminator *compiled_dis = compiled[d];
+        double *prediction = predictions[d].data();
+        for (size_t begin = 0; begin < num_points; begin += POINTS_PER_TASK) {
+            size_t end = begin + POINTS_PER_TASK;
+            if ( end > num_points ) end = num_points;
+            threadPool->submit( scoring, 
+                                [discriminator, compiled_dis, prediction,
+                                 points, begin, end] () {
+                if ( compiled_dis != 0 ) {
+                    compiled_dis->test( *points, begin, end, 
+                                        prediction + begin );
+                } else {
+                    discriminator->test( *points, begin, end, 
+                                         prediction + begin );
+                }
+            });
+        }
+    }
+    threadPool->wait( scoring );
+
+    for (unsigned d = 0; d < num_dis; ++d) {
+        delete compiled[d];
+    }
+}
+
+void SDMachine::predict( const vector<DiscriminatorView*> &dis, 
+                         DataStore &data,
+                         vector<vector<double> > &predictions ) {
+    unsigned num_dis = dis.size();
+    size_t num_points = data.size();
+
+    predictions.assign( num_dis, vector<double>( num_points, 0.0 ) );
+    if ( num_points == 0 ) return;
+
+    PointColumns columns( data[0]->noirSpace );
+    for (size_t t = 0; t < num_points; ++t) {
+        columns.add( data[t] );
+    }
+    const PointColumns *points = &columns;
 
+    ThreadPool::TaskGroup scoring;
+    for (unsigned d = 0; d < num_dis; ++d) {
+        const DiscriminatorView *discriminator = dis[d];
+        double *prediction = predictions[d].data();
+        for (size_t begin = 0; begin < num_points; begin += POINTS_PER_TASK) {
+            size_t end = begin + POINTS_PER_TASK;
+            if ( end > num_points ) end = num_points;
+            threadPool->submit( scoring, 
+                                [discriminator, prediction, points, 
+                                 begin, end] () {
+                discriminator->test( *points, begin, end, prediction + begin );
+            });
+        }
+    }
+    threadPool->wait( scoring );
+}
+
+void SDMachine::delete_mapped_discriminators() {
+    vector<DiscriminatorView*>::const_iterator dit;
+    for ( dit = mappedDiscriminators.begin(); 
+          dit != mappedDiscriminators.end(); ++dit ) {
+        delete *dit;
+    }
+    mappedDiscriminators.clear();
+
+    delete mappedFile;
+    mappedFile = 0;
+}
+
+ROC* SDMachine::test( vector<Discriminator*> &dis, DataStore &test_data ) {
     ROC *roc = new ROC();
 
     double best = 1.0;
@@ -345,28 +659,13 @@ ROC* SDMachine::test( DataStore &test_data ) {
     int predicted_color = 0;
 
     double threshold = -std::numeric_limits<double>::max();
-    if (discriminators.size() == 1) threshold = 0.5;
+    if (dis.size() == 1) threshold = 0.5;
 
-    unsigned num_dis = discriminators.size();
+    unsigned num_dis = dis.size();
     unsigned num_tests = test_data.size();
-    prediction = new double*[num_dis];
-    for (unsigned td = 0; td < num_dis; ++td) {
-        prediction[td] = new double[num_tests];
-    }
 
-    pthread_t *tid = new pthread_t[discriminators.size()];
-    thread_data *td = new thread_data[discriminators.size()];
-    for (unsigned d = 0; d < num_dis; ++d) {
-            td[d].sdm = this;
-            td[d].dis = discriminators[d];
-            td[d].dis_id = d;
-            td[d].dataStore = &test_data;
-            pthread_create( &tid[d], NULL, 
-                            test_discriminators, &td[d] );
-    }
-    for ( size_t d = 0; d < discriminators.size(); d++ ) {
-        pthread_join( tid[d], NULL );
-    }
+    vector<vector<double> > prediction;
+    predict( dis, test_data, prediction );
 
     for (unsigned td = 0; td < num_tests; ++td) {
         best = threshold;
@@ -376,7 +675,7 @@ ROC* SDMachine::test( DataStore &test_data ) {
         for (unsigned d = 0; d < num_dis; ++d) {
             if ( prediction[d][td] > best ) {
                 best = prediction[d][td];
-                predicted_color = discriminators[d]->get_principal_color();
+                predicted_color = dis[d]->get_principal_color();
             }
         }
 
@@ -395,16 +694,138 @@ ROC* SDMachine::test( DataStore &test_data ) {
         }
     }
 
-    for (unsigned d = 0; d < num_dis; ++d) {
-        delete[] prediction[d];
-    }
-    delete[] prediction;
-    delete[] tid;
-    delete[] td;
-
     return roc;
 };
 
+void SDMachine::save( const string &filename, DataManager &dataManager ) {
+    const NoirSpace *noirSpace = dataManager.get_noir_space();
+    if ( noirSpace == 0 ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                        "There are no learned discriminators to save." );
+    }
+
+    BinaryWriter out( filename );
+    out.write( FILE_MAGIC, sizeof(FILE_MAGIC) );
+    out.write_int( FILE_VERSION );
+    out.write_int( FILE_BYTE_ORDER );
+
+    out.write_int( noirSpace->nominal );
+    out.write_int( noirSpace->ordinal );
+    out.write_int( noirSpace->interval );
+    out.write_int( noirSpace->real );
+    out.write_int( modelTypes );
+
+    dataManager.write_scales( out );
+
+    out.write_int( discriminators.size() );
+    for ( size_t d = 0; d < discriminators.size(); d++ ) {
+        discriminators[d]->write( out );
+    }
+
+    out.close();
+}
+
+void SDMachine::load( const string &filename, DataManager &dataManager ) {
+    BinaryReader in( filename );
+
+    char magic[sizeof(FILE_MAGIC)];
+    in.read( magic, sizeof(magic) );
+    if ( memcmp( magic, FILE_MAGIC, sizeof(magic) ) != 0 ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                        "Not a file of saved discriminators: " + filename );
+    }
+    int64_t version = in.read_int();
+    if ( version != FILE_VERSION ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                "Unsupported version " + to_string(version) + " of: " + 
+                filename );
+    }
+    if ( in.read_int() != FILE_BYTE_ORDER ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                        "Saved with a different byte order: " + filename );
+    }
+
+    int nominal = static_cast<int>( in.read_int() );
+    int ordinal = static_cast<int>( in.read_int() );
+    int interval = static_cast<int>( in.read_int() );
+    int real = static_cast<int>( in.read_int() );
+
+    int64_t model_types = in.read_int();
+    if ( model_types == ModelTypes::Ball ) {
+        modelTypes = ModelTypes::Ball;
+    } else if ( model_types == ModelTypes::Orthotope ) {
+        modelTypes = ModelTypes::Orthotope;
+    } else {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                        "Unknown subspace type in: " + filename );
+    }
+    if ( compiledScoring && modelTypes != ModelTypes::Orthotope ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                "Compiled scoring requires Orthotopes as subspace types.");
+    }
+    if ( mappedScoring && modelTypes != ModelTypes::Orthotope ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                "Mapped scoring requires Orthotopes as subspace types.");
+    }
+
+    dataManager.read_scales( in );
+
+    // The models must live in the space of the data they are to score
+    const NoirSpace *data_space = dataManager.get_noir_space();
+    if ( data_space->nominal != nominal || data_space->ordinal != ordinal ||
+         data_space->interval != interval || data_space->real != real ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                "The fields of the data differ from those of the "
+                "discriminators saved in: " + filename );
+    }
+
+    int64_t num_dis = in.read_int();
+    if ( num_dis != dataManager.get_num_colors() ) {
+        throw util::InvalidInputError( __FILE__, __LINE__,
+                "Expected " + to_string(dataManager.get_num_colors()) +
+                " discriminators, but found " + to_string(num_dis) + 
+                " in: " + filename );
+    }
+
+    delete_discriminators( discriminators );
+    delete_mapped_discriminators();
+    delete modelSpace;
+    modelSpace = new NoirSpace( nominal, ordinal, interval, real );
+
+    // Mapped discriminators are scored where they lie in the file, which
+    // is checked once, but not read
+    if ( mappedScoring ) {
+        size_t offset = in.get_offset();
+        mappedFile = new MappedFile( filename );
+        for ( int64_t d = 0; d < num_dis; d++ ) {
+            DiscriminatorView *dis = new DiscriminatorView( modelSpace, 
+                                        mappedFile->get_data() + offset,
+                                        mappedFile->get_size() - offset );
+            mappedDiscriminators.push_back( dis );
+            if ( dis->get_principal_color() != d ) {
+                throw util::InvalidInputError( __FILE__, __LINE__,
+                    "Expected a discriminator of color " + to_string(d) +
+                    " in: " + filename );
+            }
+            offset += dis->get_record_size();
+        }
+        return;
+    }
+
+    for ( int64_t d = 0; d < num_dis; d++ ) {
+        Discriminator *dis = new Discriminator( static_cast<int>(d) );
+        discriminators.push_back( dis );
+
+        dis->set_thread_pool( threadPool );
+        if ( modelTypes == ModelTypes::Ball ) {
+            dis->set_model_factory( new BallModelFactory() );
+        } else {
+            dis->set_model_factory( new OrthotopeModelFactory() );
+        }
+        dis->read( in, modelSpace );
+    }
+}
+
 void SDMachine::process_trial_data( DataManager &dataManager ) {
     if ( dataManager.has_trial_data() ) {
         process( *dataManager.get_trial_data() );
@@ -412,32 +833,15 @@ void SDMachine::process_trial_data( DataManager &dataManager ) {
 }
 
 void SDMachine::process( DataStore &trial_data ) {
-    vector<Discriminator*>::const_iterator dit;
-    DataStore::const_iterator pit;
-
-    double threshold = -std::numeric_limits<double>::max();
-    if (discriminators.size() == 1) threshold = 0.5;
-
-    unsigned num_dis = discriminators.size();
     unsigned num_trials = trial_data.size();
-    prediction = new double*[num_dis];
-    for (unsigned td = 0; td < num_dis; ++td) {
-        prediction[td] = new double[num_trials];
-    }
 
-    pthread_t *tid = new pthread_t[discriminators.size()];
-    thread_data *td = new thread_data[discriminators.size()];
-    for (unsigned d = 0; d < num_dis; ++d) {
-            td[d].sdm = this;
-            td[d].dis = discriminators[d];
-            td[d].dis_id = d;
-            td[d].dataStore = &trial_data;
-            pthread_create( &tid[d], NULL, 
-                            test_discriminators, &td[d] );
-    }
-    for ( size_t d = 0; d < discriminators.size(); d++ ) {
-        pthread_join( tid[d], NULL );
+    vector<vector<double> > prediction;
+    if ( mappedFile != 0 ) {
+        predict( mappedDiscriminators, trial_data, prediction );
+    } else {
+        predict( discriminators, trial_data, prediction );
     }
+    unsigned num_dis = prediction.size();
 
     for (unsigned td = 0; td < num_trials; ++td) {
 
@@ -448,14 +852,6 @@ void SDMachine::process( DataStore &trial_data ) {
         }
         fprintf(stdout,"\n");
     }
-
-    for (unsigned d = 0; d < num_dis; ++d) {
-        delete[] prediction[d];
-    }
-    delete[] prediction;
-    delete[] tid;
-    delete[] td;
-
 };
 
 
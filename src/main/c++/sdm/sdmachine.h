@@ -17,16 +17,21 @@
 #ifndef SDM_SD_MACHINE_H
 #define SDM_SD_MACHINE_H
 
+#include <string>
 #include <vector>
 #include <map>
 
+#include "noir/noir_space.h"
 #include "sdm/data_store.h"
 #include "sdm/model.h"
 #include "sdm/discriminator.h"
+#include "sdm/discriminator_view.h"
 #include "sdm/data_manager.h"
 #include "rng/random.h"
 #include "stat/roc.h"
+#include "util/mapped_file.h"
 #include "util/properties.h"
+#include "util/thread_pool.h"
 
 namespace sdm {
 
@@ -36,9 +41,17 @@ namespace sdm {
  */
 class SDMachine {
  public:
-    explicit SDMachine() : discriminators(), uniform(0), numModels(100), 
-                           numFolds(8), numAttempts(100), lowerFrac(0.0), 
-                           upperFrac(0.1), enrichmentLevel(0.1) {}
+    explicit SDMachine() : discriminators(), foldRandoms(), uniform(0), 
+                           threadPool(0),
+                           numModels(100), numFolds(8), numAttempts(100),
+                           numThreads(0), batchSize(1),
+                           lowerFrac(0.0), upperFrac(0.1),
+                           enrichmentLevel(0.1), concurrentFolds(false),
+                           nnSearch( NearestNeighborSearch::Automatic ),
+                           compiledScoring(false), compiledMemory(256),
+                           mappedScoring(false),
+                           modelSpace(0), mappedFile(0),
+                           mappedDiscriminators() {}
 
     virtual ~SDMachine();
 
@@ -59,6 +72,29 @@ class SDMachine {
     void ready_discriminator( Discriminator *dis, DataManager &dataManager, 
                               const int &skip_fold );
 
+    /*
+     * Saves the learned discriminators to the specified file, together
+     * with the scales of the data manager by which further data is read.
+     * The file starts with a magic string and the version of its format.
+     */
+    void save( const std::string &filename, DataManager &dataManager );
+
+    /*
+     * Loads the discriminators saved to the specified file in place of any
+     * learned, and restores the scales of the data manager, which must have
+     * been initialized with the same fields, before any data is loaded.
+     * With mapped scoring, discriminators of orthotopes are not read but
+     * mapped into memory and scored in place.
+     */
+    void load( const std::string &filename, DataManager &dataManager );
+
+    /*
+     * Retrieve the discriminators learned or loaded.
+     */
+    const std::vector<Discriminator*>& get_discriminators() const {
+        return discriminators;
+    }
+
     /*
      * Process the trial data held by the data manager, if any.
      */
@@ -72,28 +108,68 @@ class SDMachine {
  private:
     std::vector<Discriminator*> discriminators;
     std::vector<stat::ROC*> learning_results;
+
+    // The random number generators of the folds: for each fold and color
+    // the generator of the discriminator followed by its random streams
+    std::vector<std::vector<std::vector<rng::Random*> > > foldRandoms;
     rng::Random *uniform;
+    util::ThreadPool *threadPool;
     util::Properties *sdmParameters;
     ModelTypes::Types modelTypes;
     int numModels;
     int numFolds;
     int numAttempts;
+    int numThreads;
+    int batchSize;
     double lowerFrac;
     double upperFrac;
     double enrichmentLevel;
+    bool concurrentFolds;
+    NearestNeighborSearch::Types nnSearch;
+    bool compiledScoring;
+    // The memory, in megabytes, which the tables of the compiled
+    // discriminators may take at the same time
+    int compiledMemory;
+    bool mappedScoring;
+
+    // The space of the models loaded from a file
+    noir::NoirSpace *modelSpace;
+
+    // The file of saved discriminators mapped for scoring, and views of
+    // the discriminators in it
+    util::MappedFile *mappedFile;
+    std::vector<DiscriminatorView*> mappedDiscriminators;
     LearningAlgorithms learningAlgorithm;
 
     rng::Random* initialize_uniform_rng( const util::Properties &props );
     void clear_learning_results();
-    void create_discriminators( DataManager &dataManager );
+    void create_discriminators( DataManager &dataManager,
+                                std::vector<Discriminator*> &created );
+    void delete_discriminators( std::vector<Discriminator*> &dis );
+    void create_fold_randoms( const int &num_colors, const int &num_folds );
+    void set_fold_randoms( std::vector<Discriminator*> &dis, 
+                           const int &fold );
+    void delete_fold_randoms();
     void ready_discriminators( DataManager &dataManager, const int &part );
-    void train_discriminators();
+    void train_discriminators( std::vector<Discriminator*> &dis,
+                               DataManager &dataManager,
+                               const int &skip_fold );
+
+    void predict( std::vector<Discriminator*> &dis, DataStore &data,
+                  std::vector<std::vector<double> > &predictions );
+    void predict( const std::vector<DiscriminatorView*> &dis, 
+                  DataStore &data,
+                  std::vector<std::vector<double> > &predictions );
+    void delete_mapped_discriminators();
 
-    stat::ROC* test( DataStore &testData );
+    stat::ROC* test( std::vector<Discriminator*> &dis, DataStore &testData );
 
     void process( DataStore &trialData );
 
     void folded_learning( DataManager &dataManager );
+    void learn_folds_serially( DataManager &dataManager );
+    void learn_folds_concurrently( DataManager &dataManager );
+    void report( stat::ROC *result );
     void simple_learning( DataManager &dataManager );
     template<typename ValueType>
     inline void set_value(const std::string &name, ValueType &value);
@@ -0,0 +1,132 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef SDM_SPACE_MODEL_H
+#define SDM_SPACE_MODEL_H
+
+#include <cstddef>
+#include <vector>
+
+#include "noir/point.h"
+#include "noir/point_columns.h"
+#include "sdm/model.h"
+
+namespace sdm {
+
+/*
+ * A Model whose subspaces are all of the type Space. The subspaces are kept
+ * as a Space, not as a ClosedSpace, so that testing a point against them
+ * calls Space::in_closure directly, which the compiler is free to inline,
+ * instead of going through the virtual ClosedSpace interface for every
+ * subspace.
+ */
+template <typename Space>
+class SpaceModel : public Model {
+ public:
+    SpaceModel(const int &principal_color, 
+               const double &total_principal_colors,
+               const double &total_other_colors):
+               Model( principal_color, total_principal_colors, 
+                      total_other_colors ), spaces() {}
+
+    virtual ~SpaceModel(){
+        // The subspaces live in the arena, which frees their memory in bulk
+        for ( size_t s = 0; s < spaces.size(); ++s ) {
+            spaces[s]->~Space();
+        }
+    }
+
+    /*
+     * Retrieves the s-th subspace of this model.
+     */
+    const Space* get_space( const size_t &s ) const {
+        return spaces[s];
+    }
+
+ protected:
+    std::vector<Space*> spaces;
+
+    size_t num_spaces() const {
+        return spaces.size();
+    }
+
+    bool in_spaces( const noir::Point *point ) const {
+        for ( size_t s = 0; s < spaces.size(); ++s ) {
+            if ( spaces[s]->in_closure( point ) ) return true;
+        }
+        return false;
+    }
+
+    void in_spaces( const noir::PointColumns &points,
+                    const size_t &first_space, const size_t &begin,
+                    const size_t &end, char *inside ) const;
+
+    void write_spaces( util::BinaryWriter &out ) const {
+        for ( size_t s = 0; s < spaces.size(); ++s ) {
+            spaces[s]->write( out );
+        }
+    }
+
+    void read_spaces( util::BinaryReader &in, 
+                      const noir::NoirSpace *noirSpace,
+                      const size_t &num_spaces ) {
+        for ( size_t s = 0; s < num_spaces; ++s ) {
+            Space *space = new_space( noirSpace );
+            spaces.push_back( space );
+            space->read( in );
+        }
+    }
+
+    /*
+     * Creates an empty subspace in the specified space, taking its storage
+     * from the arena of this model.
+     */
+    virtual Space* new_space( const noir::NoirSpace *noirSpace ) = 0;
+
+ private:
+    // The number of points tested against a subspace at a time
+    static const size_t CHUNK = 256;
+};
+
+template <typename Space>
+void SpaceModel<Space>::in_spaces( const noir::PointColumns &points,
+                                   const size_t &first_space,
+                                   const size_t &begin, const size_t &end,
+                                   char *inside ) const {
+    for ( size_t k = 0; k < end - begin; ++k ) {
+        inside[k] = 0;
+    }
+
+    // The points are taken in chunks small enough for the answers of a
+    // subspace to stay on the stack
+    char in_space[CHUNK];
+    for ( size_t first = begin; first < end; first += CHUNK ) {
+        size_t last = first + CHUNK;
+        if ( last > end ) last = end;
+        char *chunk_inside = inside + (first - begin);
+
+        for ( size_t s = first_space; s < spaces.size(); ++s ) {
+            spaces[s]->in_closure( points, first, last, in_space );
+            for ( size_t k = 0; k < last - first; ++k ) {
+                chunk_inside[k] |= in_space[k];
+            }
+        }
+    }
+}
+
+}   // end namespace sdm
+
+#endif   // SDM_SPACE_MODEL_H
@@ -16,109 +16,544 @@
 
 #include "sdm/training_data.h"
 
-#include <set>
+#include <algorithm>
 #include <cstdio>
+#include <functional>
 #include <limits>
+#include <new>
+#include <queue>
 
 #include "sdm/covered_point.h"
 #include "sdm/data_store.h"
 #include "rng/random.h"
+#include "noir/hnsw_graph.h"
 #include "noir/noir_space.h"
+#include "noir/point.h"
+#include "noir/point_columns.h"
+#include "noir/vp_tree.h"
 
 namespace sdm {
 
-using std::map;
-using std::multiset;
 using std::pair;
 using std::vector;
+using noir::HNSWGraph;
 using noir::NoirSpace;
 using noir::Norm;
+using noir::Point;
+using noir::PointColumns;
+using noir::VPTree;
+
+namespace {
+
+// Number of children of a node of the coverage heap
+const size_t HEAP_ARITY = 4;
+
+// Number of points in a tile of the all-pairs nearest neighbour search
+const size_t NN_TILE = 256;
+
+// Width of the beam searched for an approximate nearest neighbour
+const int NN_EF_SEARCH = 16;
+
+// Number of approximate nearest neighbour queries run by a single task
+const size_t NN_QUERIES_PER_TASK = 256;
+
+// Offers a candidate at the specified distance as nearest neighbour. Of
+// several candidates at the same distance the first one is kept.
+inline void offer_nn( const double &dist, const int &candidate, 
+                      double &nearest_dist, int &nearest ) {
+    if ( dist < nearest_dist || 
+         ( dist == nearest_dist && candidate < nearest ) ) {
+        nearest_dist = dist;
+        nearest = candidate;
+    }
+}
+
+}  // namespace
 
 TrainingData::~TrainingData (){
     vector<CoveredPoint*>::iterator pit;
-    for ( pit = data.begin(); pit != data.end(); ++pit){
+    for ( pit = ownedPoints.begin(); pit != ownedPoints.end(); ++pit){
         delete *pit;
     }
-    data.clear();
+    ownedPoints.clear();
+    release_pool();
+    delete columnarData;
 }
 
 
 void TrainingData::add( CoveredPoint *const p ) {
+    ownedPoints.push_back( p );
+    insert( p );
+}
+
+void TrainingData::insert( CoveredPoint *const p ) {
+    if ( columnarData == 0 ) {
+        columnarData = new ColumnarDataStore( p->get_noir_space() );
+    }
+    columnarData->add( p->get_data_point() );
+
     data.push_back( p );
+    coverage.push_back( 0.0 );
     if ( principalColor == p->get_color() ){
+        int index = static_cast<int>(pcData.size());
+        p->set_principal_index( index );
         pcData.push_back( p );
-        pcOrderedData.insert(p);
+        pcPositions.push_back( static_cast<int>(data.size() - 1) );
+        coverageHeap.push_back( index );
+        heapPositions.push_back( index );
+        sift_up( coverageHeap.size() - 1 );
         ++numPrincipalColor;
     } else {
         ++numOtherColor;
     }
 }
 
-CoveredPoint* TrainingData::get_least_covered(int rank) {
+void TrainingData::select( const vector<DataStore*> &folds, 
+                           const int &skip_fold ) {
+    bool pooled = poolSources.size() == folds.size();
+    for ( size_t f = 0; pooled && f < folds.size(); ++f ){
+        pooled = poolSources[f] == folds[f] && 
+                 poolSizes[f] == folds[f]->size();
+    }
+
+    vector<CoveredPoint*>::iterator pit;
+    for ( pit = ownedPoints.begin(); pit != ownedPoints.end(); ++pit){
+        delete *pit;
+    }
+    ownedPoints.clear();
+    reset();
+
+    if ( pooled ) {
+        ++numPoolReuses;
+    } else {
+        release_pool();
+        for ( size_t f = 0; f < folds.size(); ++f ){
+            DataStore::const_iterator dit;
+            for ( dit = folds[f]->begin(); dit != folds[f]->end(); ++dit ){
+                void *slot = poolArena.allocate( sizeof(CoveredPoint), 
+                                                 alignof(CoveredPoint) );
+                pool.push_back( new (slot) CoveredPoint( *dit ) );
+                poolFolds.push_back( static_cast<int>(f) );
+            }
+            poolSources.push_back( folds[f] );
+            poolSizes.push_back( folds[f]->size() );
+        }
+    }
+
+    for ( size_t p = 0; p < pool.size(); ++p ){
+        if ( poolFolds[p] != skip_fold ) insert( pool[p] );
+    }
+}
+
+void TrainingData::release_pool() {
+    vector<CoveredPoint*>::iterator pit;
+    for ( pit = pool.begin(); pit != pool.end(); ++pit){
+        (*pit)->~CoveredPoint();
+    }
+    pool.clear();
+    poolFolds.clear();
+    poolSources.clear();
+    poolSizes.clear();
+    poolArena.release();
+}
+
+void TrainingData::increment_coverage( const size_t &index, 
+                                       const double &inc ) {
+    coverage[index] += inc;
+
+    int point = data[index]->get_principal_index();
+    if ( principalColor != data[index]->get_color() || point < 0 ) return;
+    if ( inc < 0.0 ) {
+        sift_up( heapPositions[point] );
+    } else {
+        sift_down( heapPositions[point] );
+    }
+}
+
+void TrainingData::place_in_heap( const size_t &position, const int &point ) {
+    coverageHeap[position] = point;
+    heapPositions[point] = static_cast<int>(position);
+}
 
-    if ( rank == 0 ) return *(pcOrderedData.begin());
+void TrainingData::sift_up( size_t position ) {
+    int point = coverageHeap[position];
+    while ( position > 0 ) {
+        size_t parent = (position - 1)/HEAP_ARITY;
+        if ( !less_covered( point, coverageHeap[parent] ) ) break;
+        place_in_heap( position, coverageHeap[parent] );
+        position = parent;
+    }
+    place_in_heap( position, point );
+}
 
-    int numit = 0;
-    multiset<CoveredPoint*,CoveredPoint::CompareCoverage>::iterator pit;
-    for ( pit = pcOrderedData.begin(); pit != pcOrderedData.end(); ++pit){
-        if ( numit == rank ) break;
-        ++numit;
+void TrainingData::sift_down( size_t position ) {
+    int point = coverageHeap[position];
+    size_t size = coverageHeap.size();
+    while ( true ) {
+        size_t first = position*HEAP_ARITY + 1;
+        if ( first >= size ) break;
+        size_t last = std::min( first + HEAP_ARITY, size );
+        size_t least = first;
+        for ( size_t child = first + 1; child < last; ++child ){
+            if ( less_covered( coverageHeap[child], coverageHeap[least] ) ) {
+                least = child;
+            }
+        }
+        if ( !less_covered( coverageHeap[least], point ) ) break;
+        place_in_heap( position, coverageHeap[least] );
+        position = least;
     }
-    
-    return *pit;
+    place_in_heap( position, point );
+}
+
+CoveredPoint* TrainingData::get_least_covered() {
+    return pcData[coverageHeap[0]];
+}
+
+CoveredPoint* TrainingData::get_least_covered(int rank) {
+    if ( rank <= 0 ) return get_least_covered();
+    if ( rank >= static_cast<int>(coverageHeap.size()) ) {
+        rank = static_cast<int>(coverageHeap.size()) - 1;
+    }
+
+    // The points ranked below rank form the top of the heap, so they are
+    // taken from it in order without touching the rest of the heap
+    auto greater = [this]( const size_t &a, const size_t &b ){
+        return less_covered( coverageHeap[b], coverageHeap[a] );
+    };
+    std::priority_queue<size_t, vector<size_t>, decltype(greater)> 
+                                                        frontier( greater );
+    frontier.push( 0 );
+    for ( int r = 0; r < rank; ++r ){
+        size_t position = frontier.top();
+        frontier.pop();
+        size_t first = position*HEAP_ARITY + 1;
+        size_t last = std::min( first + HEAP_ARITY, coverageHeap.size() );
+        for ( size_t child = first; child < last; ++child ){
+            frontier.push( child );
+        }
+    }
+
+    return pcData[coverageHeap[frontier.top()]];
 }
 
 CoveredPoint* TrainingData::get_random_point() {
-    int randomPoint = rand->next_int( static_cast<int>(pcData.size()) );
+    return get_random_point( rand );
+}
+
+CoveredPoint* TrainingData::get_random_point( rng::Random *random ) const {
+    int randomPoint = random->next_int( static_cast<int>(pcData.size()) );
     return pcData[randomPoint];
 }
 
 
 void TrainingData::reorder(){
-    pcOrderedData.clear();
-    vector<CoveredPoint*>::iterator pit;
-    for ( pit = pcData.begin(); pit != pcData.end(); ++pit){
-    //for ( pit = data.begin(); pit != data.end(); ++pit){
-        pcOrderedData.insert(*pit);
-    }
-}
-
-void TrainingData::find_nn(){
-    const Norm norm =
-                (*pcData.begin())->get_data_point()->noirSpace->norm;
-    vector<CoveredPoint*>::iterator ipit;
-    vector<CoveredPoint*>::iterator jpit;
-    for ( ipit = pcData.begin(); ipit != pcData.end(); ++ipit){
-        double dist = std::numeric_limits<double>::max();
-        CoveredPoint *nnpoint = 0;
-        for ( jpit = pcData.begin(); jpit != pcData.end(); ++jpit){
-            if ( jpit == ipit ) continue;
-            double ijdist = norm( (*ipit)->get_data_point(), 
-                                    (*jpit)->get_data_point() );
-            if ( ijdist < dist ) {
-                dist = ijdist;
-                nnpoint = *jpit;
+    for ( size_t position = coverageHeap.size(); position > 0; --position ){
+        sift_down( position - 1 );
+    }
+}
+
+void TrainingData::find_nn( util::ThreadPool *thread_pool ){
+    nearestNeighbors.assign( pcData.size(), -1 );
+    if ( pcData.empty() ) return;
+
+    if ( nnCache != 0 && nnSearch != NearestNeighborSearch::Approximate &&
+         find_nn_cached() ) {
+        return;
+    }
+
+    if ( nnSearch == NearestNeighborSearch::Tree ) {
+        find_nn_tree();
+        return;
+    } else if ( nnSearch == NearestNeighborSearch::Blocked ) {
+        find_nn_blocked( thread_pool );
+        return;
+    } else if ( nnSearch == NearestNeighborSearch::Approximate ) {
+        find_nn_approximate( thread_pool );
+        return;
+    }
+
+    // The tree holds only the complete points, and it prunes poorly when
+    // the norm is dominated by nominal coordinates, which are either equal
+    // or not.
+    const NoirSpace *noirSpace = pcData[0]->get_noir_space();
+    size_t num_complete = 0;
+    vector<CoveredPoint*>::const_iterator pit;
+    for ( pit = pcData.begin(); pit != pcData.end(); ++pit ){
+        if ( VPTree::is_complete( (*pit)->get_data_point() ) ) ++num_complete;
+    }
+    bool nominal_heavy = noirSpace->nominal > 
+                  noirSpace->ordinal + noirSpace->interval + noirSpace->real;
+
+    if ( nominal_heavy || 2*num_complete < pcData.size() ) {
+        find_nn_blocked( thread_pool );
+    } else {
+        find_nn_tree();
+    }
+}
+
+bool TrainingData::find_nn_cached(){
+    if ( nnCache->get_color() != principalColor ) return false;
+
+    size_t num_points = pcData.size();
+    vector<int> number( num_points );
+    vector<int> position( nnCache->size(), -1 );
+    for ( size_t i = 0; i < num_points; ++i ){
+        number[i] = nnCache->find( pcData[i]->get_data_point() );
+        if ( number[i] < 0 ) return false;
+        position[number[i]] = static_cast<int>(i);
+    }
+
+    // The nearest neighbour is the first cached one present here. Only if
+    // all of them are absent are the points scanned, in order.
+    const int num_neighbors = nnCache->get_num_neighbors();
+    PointColumns *columns = 0;
+    vector<double> dist;
+    for ( size_t i = 0; i < num_points; ++i ){
+        const int *neighbors = nnCache->get_neighbors( number[i] );
+        int nearest = -1;
+        int r = 0;
+        for ( ; r < num_neighbors && neighbors[r] >= 0; ++r ){
+            if ( position[neighbors[r]] >= 0 ) {
+                nearest = position[neighbors[r]];
+                break;
+            }
+        }
+
+        if ( nearest < 0 && r == num_neighbors ) {
+            if ( columns == 0 ) {
+                columns = new PointColumns( pcData[0]->get_noir_space() );
+                columns->reserve( num_points );
+                for ( size_t p = 0; p < num_points; ++p ){
+                    columns->add( pcData[p]->get_data_point() );
+                }
+                dist.resize( num_points );
+            }
+            double nearest_dist = std::numeric_limits<double>::max();
+            const Norm &norm = pcData[i]->get_noir_space()->norm;
+            norm( pcData[i]->get_data_point(), *columns, 0, num_points, 
+                  &dist[0] );
+            for ( size_t j = 0; j < num_points; ++j ){
+                if ( j == i ) continue;
+                if ( dist[j] < nearest_dist ) {
+                    nearest = static_cast<int>(j);
+                    nearest_dist = dist[j];
+                }
+            }
+        }
+
+        nearestNeighbors[i] = nearest;
+    }
+    delete columns;
+
+    return true;
+}
+
+void TrainingData::find_nn_tree(){
+    const NoirSpace *noirSpace = (*pcData.begin())->get_noir_space();
+    const Norm norm = noirSpace->norm;
+    size_t num_points = pcData.size();
+
+    // Complete points go into a vantage point tree. Points with missing
+    // coordinates break the triangle inequality, so they are compared with
+    // every point using the batched form of the norm.
+    vector<const Point*> tree_points;
+    vector<int> tree_index;
+    vector<int> tree_position( num_points, -1 );
+    vector<int> incomplete_index;
+    PointColumns all_columns( noirSpace );
+    PointColumns incomplete_columns( noirSpace );
+    all_columns.reserve( num_points );
+    for ( size_t p = 0; p < num_points; ++p ){
+        const Point *point = pcData[p]->get_data_point();
+        all_columns.add( point );
+        if ( VPTree::is_complete( point ) ) {
+            tree_position[p] = static_cast<int>(tree_points.size());
+            tree_points.push_back( point );
+            tree_index.push_back( static_cast<int>(p) );
+        } else {
+            incomplete_columns.add( point );
+            incomplete_index.push_back( static_cast<int>(p) );
+        }
+    }
+
+    VPTree tree( tree_points );
+
+    // Of several points at the same distance the first one is chosen
+    vector<double> dist( num_points );
+    for ( size_t i = 0; i < num_points; ++i ){
+        const Point *point = pcData[i]->get_data_point();
+        int nearest = -1;
+        double nearest_dist = std::numeric_limits<double>::max();
+
+        if ( tree_position[i] >= 0 ) {
+            double tree_dist = 0.0;
+            int t = tree.nearest( point, tree_position[i], tree_dist );
+            if ( t >= 0 ) {
+                nearest = tree_index[t];
+                nearest_dist = tree_dist;
+            }
+
+            size_t num_incomplete = incomplete_index.size();
+            if ( num_incomplete > 0 ) {
+                norm( point, incomplete_columns, 0, num_incomplete, 
+                      &dist[0] );
+            }
+            for ( size_t k = 0; k < num_incomplete; ++k ){
+                int j = incomplete_index[k];
+                if ( dist[k] < nearest_dist || 
+                     ( dist[k] == nearest_dist && j < nearest ) ) {
+                    nearest = j;
+                    nearest_dist = dist[k];
+                }
+            }
+        } else {
+            norm( point, all_columns, 0, num_points, &dist[0] );
+            for ( size_t j = 0; j < num_points; ++j ){
+                if ( j == i ) continue;
+                if ( dist[j] < nearest_dist ) {
+                    nearest = static_cast<int>(j);
+                    nearest_dist = dist[j];
+                }
             }
         }
-        nn[*ipit] = nnpoint;
+
+        nearestNeighbors[i] = nearest;
     }
 }
 
-CoveredPoint* TrainingData::get_nn(CoveredPoint *cp) {
-    return nn[cp];
+void TrainingData::find_nn_blocked( util::ThreadPool *thread_pool ){
+    const NoirSpace *noirSpace = pcData[0]->get_noir_space();
+    const Norm norm = noirSpace->norm;
+    size_t num_points = pcData.size();
+
+    PointColumns columns( noirSpace );
+    columns.reserve( num_points );
+    for ( size_t p = 0; p < num_points; ++p ){
+        columns.add( pcData[p]->get_data_point() );
+    }
+
+    vector<double> nearest_dist( num_points, 
+                                 std::numeric_limits<double>::max() );
+    size_t num_tiles = (num_points + NN_TILE - 1)/NN_TILE;
+
+    // Compares the points of tile a with those of tile b >= a. The distance
+    // of each pair is computed once, from the point of lower index, and
+    // offered to both points.
+    auto compare_tiles = [&]( const size_t &a, const size_t &b ){
+        size_t a_end = std::min( (a + 1)*NN_TILE, num_points );
+        size_t b_end = std::min( (b + 1)*NN_TILE, num_points );
+        double dist[NN_TILE];
+        for ( size_t i = a*NN_TILE; i < a_end; ++i ){
+            size_t begin = a == b ? i + 1 : b*NN_TILE;
+            if ( begin >= b_end ) continue;
+            norm( pcData[i]->get_data_point(), columns, begin, b_end, dist );
+            for ( size_t j = begin; j < b_end; ++j ){
+                offer_nn( dist[j - begin], static_cast<int>(j), 
+                          nearest_dist[i], nearestNeighbors[i] );
+                offer_nn( dist[j - begin], static_cast<int>(i), 
+                          nearest_dist[j], nearestNeighbors[j] );
+            }
+        }
+    };
+
+    auto for_each = [&]( const size_t &count, 
+                         const std::function<void(size_t)> &function ){
+        if ( thread_pool == 0 ) {
+            for ( size_t k = 0; k < count; ++k ) function( k );
+            return;
+        }
+        thread_pool->parallel_for( 0, count, 1, 
+                                   [&]( size_t begin, size_t end ){
+            for ( size_t k = begin; k < end; ++k ) function( k );
+        });
+    };
+
+    // The tiles on the diagonal first, then the pairs of distinct tiles in
+    // rounds of a round-robin tournament. No tile takes part twice in a
+    // round, so concurrent tasks never update the same points. The results
+    // do not depend on the order in which the pairs are compared.
+    for_each( num_tiles, [&]( size_t k ){ compare_tiles( k, k ); } );
+
+    size_t slots = num_tiles + num_tiles % 2;
+    for ( size_t round = 0; round + 1 < slots; ++round ){
+        for_each( slots/2, [&]( size_t k ){
+            size_t a = round;
+            size_t b = slots - 1;
+            if ( k > 0 ) {
+                a = (round + k) % (slots - 1);
+                b = (round + slots - 1 - k) % (slots - 1);
+            }
+            if ( a > b ) std::swap( a, b );
+            if ( b < num_tiles ) compare_tiles( a, b );
+        });
+    }
+}
+
+void TrainingData::find_nn_approximate( util::ThreadPool *thread_pool ){
+    size_t num_points = pcData.size();
+
+    vector<const Point*> points( num_points );
+    for ( size_t p = 0; p < num_points; ++p ){
+        points[p] = pcData[p]->get_data_point();
+    }
+
+    HNSWGraph graph( points, thread_pool );
+
+    // Each query only reads the graph and writes its own result
+    auto query = [&]( size_t begin, size_t end ){
+        for ( size_t i = begin; i < end; ++i ){
+            double dist = 0.0;
+            nearestNeighbors[i] = graph.nearest( points[i], 
+                                                 static_cast<int>(i), 
+                                                 NN_EF_SEARCH, dist );
+        }
+    };
+
+    if ( thread_pool == 0 ) {
+        query( 0, num_points );
+    } else {
+        thread_pool->parallel_for( 0, num_points, NN_QUERIES_PER_TASK, 
+                                   query );
+    }
+}
+
+CoveredPoint* TrainingData::get_nn(CoveredPoint *cp) const {
+    int index = cp->get_principal_index();
+    if ( index < 0 || index >= static_cast<int>(nearestNeighbors.size()) ) {
+        return 0;
+    }
+    int nearest = nearestNeighbors[index];
+    return nearest >= 0 ? pcData[nearest] : 0;
 }
 
 void TrainingData::clear(){
 
     vector<CoveredPoint*>::iterator pit;
-    for ( pit = data.begin(); pit != data.end(); ++pit){
+    for ( pit = ownedPoints.begin(); pit != ownedPoints.end(); ++pit){
         delete *pit;
     }
+    ownedPoints.clear();
+    release_pool();
 
+    reset();
+    delete columnarData;
+    columnarData = 0;
+}
+
+/*
+ * Removes all points, without deleting them or giving up the memory of the
+ * containers, and clears all registers and counters.
+ */
+void TrainingData::reset(){
     data.clear();
+    if ( columnarData != 0 ) columnarData->clear();
     pcData.clear();
-    nn.clear();
-    pcOrderedData.clear();
+    nearestNeighbors.clear();
+    coverage.clear();
+    pcPositions.clear();
+    coverageHeap.clear();
+    heapPositions.clear();
 
     numPrincipalColor = 0;
     numOtherColor = 0;
@@ -17,15 +17,28 @@
 #ifndef SDM_TRAINING_DATA_H
 #define SDM_TRAINING_DATA_H
 
-#include <map>
-#include <set>
+#include <cstddef>
+#include <vector>
 
+#include "sdm/columnar_data_store.h"
 #include "sdm/covered_point.h"
 #include "sdm/data_store.h"
+#include "sdm/nearest_neighbor_cache.h"
 #include "rng/random.h"
+#include "util/arena.h"
+#include "util/thread_pool.h"
 
 namespace sdm {
 
+/*
+ * The ways of finding the nearest neighbours of the training points.
+ * Automatic chooses between the exact Tree and Blocked searches, Approximate
+ * gives a near neighbour in sublinear time.
+ */
+struct NearestNeighborSearch{
+    enum Types{ Automatic, Tree, Blocked, Approximate };
+};
+
 /*
  * Training Data is used during the learning stage.
  */
@@ -33,9 +46,14 @@ class TrainingData{
 public:
 
     TrainingData ( const int &principal_color = 0): data(), pcData(), 
-                   pcOrderedData(),
+                   ownedPoints(), poolArena(1 << 16), pool(), poolFolds(),
+                   poolSources(), poolSizes(), numPoolReuses(0),
+                   coverage(), pcPositions(), coverageHeap(), 
+                   heapPositions(), nearestNeighbors(),
                    principalColor( principal_color ),numPrincipalColor(0),
-                   numOtherColor(0),rand(NULL) {}
+                   numOtherColor(0),rand(NULL), columnarData(0),
+                   nnSearch( NearestNeighborSearch::Automatic ),
+                   nnCache(0) {}
 
     virtual ~TrainingData ();
 
@@ -46,6 +64,21 @@ public:
         rand = random;
     }
 
+    /*
+     * Set the way in which find_nn finds the nearest neighbours.
+     */
+    void set_nn_search( const NearestNeighborSearch::Types &nn_search ){
+        nnSearch = nn_search;
+    }
+
+    /*
+     * Set the cache from which the exact nearest neighbours are taken, if
+     * it holds the principal color points. Set 0 for no cache.
+     */
+    void set_nn_cache( const NearestNeighborCache *nn_cache ){
+        nnCache = nn_cache;
+    }
+
     /*
      * Retrieve the number of data points in the training data
      */
@@ -88,10 +121,42 @@ public:
     }
 
     /*
-     * Add a covered point to the training data
+     * Retrieve the data point at the specified position
+     */
+    inline CoveredPoint* operator[]( const size_t &index ) const {
+        return data[index];
+    }
+
+    /*
+     * Retrieve the columnar copy of the training points. The index of a point
+     * in the columns is its position in the training data.
+     */
+    inline const ColumnarDataStore& get_columnar_data() const {
+        return *columnarData;
+    }
+
+    /*
+     * Add a covered point to the training data, which takes ownership of it
      */
     void add( CoveredPoint *const p );
 
+    /*
+     * Use the points of all of the specified folds but skip_fold as the
+     * training data, in the order of the folds, replacing any points held
+     * before. The first call creates a pool of covered points for all
+     * points of the folds; later calls for the same folds only reset the
+     * coverage and choose the member points anew, without allocating.
+     */
+    void select( const std::vector<DataStore*> &folds, const int &skip_fold );
+
+    /*
+     * Retrieve the number of times select reused the pool of covered points
+     * created by an earlier call.
+     */
+    int get_num_pool_reuses() const {
+        return numPoolReuses;
+    }
+
     /*
      * Get the number data points belonging to the principal color (class)
      */
@@ -114,13 +179,29 @@ public:
     }
 
     
+    /*
+     * Retrieve the coverage of the data point at the specified position
+     */
+    double get_coverage( const size_t &index ) const {
+        return coverage[index];
+    }
+
+    /*
+     * Increment the coverage of the data point at the specified position.
+     * The order of the principal color points by coverage is updated at
+     * once, so concurrent calls are not allowed.
+     */
+    void increment_coverage( const size_t &index, const double &inc );
+
     /*
      * Get the least covered data point in this container
      */
     CoveredPoint* get_least_covered();
 
     /*
-     * Get the rank-th least covered data point in this container
+     * Get the rank-th least covered data point in this container. Of points
+     * with the same coverage the one added first ranks first. A rank beyond
+     * the number of points gives the most covered point.
      */
     CoveredPoint* get_least_covered(int rank);
 
@@ -130,17 +211,29 @@ public:
     CoveredPoint* get_random_point();
 
     /*
-     * Create a list of nearest neighbors to each point
+     * Get a random data point from this container using the specified
+     * random number generator
      */
-    void find_nn();
+    CoveredPoint* get_random_point( rng::Random *random ) const;
+
+    /*
+     * Create a list of nearest neighbors to each point. Unless another way
+     * has been set, spaces in which a vantage point tree works well are
+     * searched with one; others, such as spaces dominated by nominal
+     * coordinates, are searched with a tiled pass over all pairs of points.
+     * The work is shared out over the specified pool of threads, if any.
+     */
+    void find_nn( util::ThreadPool *thread_pool = 0 );
 
     /*
      * Get the nearest neighbor point to the specified point
      */
-    CoveredPoint* get_nn(CoveredPoint *cp);
+    CoveredPoint* get_nn(CoveredPoint *cp) const;
 
     /*
-     * Sort the points in order of their coverge.
+     * Sort the points in order of their coverge. As the order is kept up to
+     * date by increment_coverage, this is only needed to restore it after
+     * points have been added.
      */
     void reorder();
 
@@ -152,12 +245,55 @@ public:
 private:
     std::vector<CoveredPoint *> data;
     std::vector<CoveredPoint *> pcData;
-    std::multiset<CoveredPoint *, CoveredPoint::CompareCoverage> pcOrderedData;
-    std::map<CoveredPoint *,CoveredPoint *> nn;
+    std::vector<CoveredPoint *> ownedPoints;
+
+    // Covered points for all points of a set of folds, the fold of each
+    // point, and the folds, with their sizes, for which they were created
+    util::Arena poolArena;
+    std::vector<CoveredPoint *> pool;
+    std::vector<int> poolFolds;
+    std::vector<const DataStore*> poolSources;
+    std::vector<size_t> poolSizes;
+    int numPoolReuses;
+
+    // The coverage of each point, and the positions of the principal color
+    // points among all points
+    std::vector<double> coverage;
+    std::vector<int> pcPositions;
+
+    // A 4-ary min-heap of the principal color points, ordered by coverage
+    // and then by principal index, and the position of each point in it
+    std::vector<int> coverageHeap;
+    std::vector<int> heapPositions;
+
+    std::vector<int> nearestNeighbors;
     int principalColor;
     int numPrincipalColor;
     int numOtherColor;
     rng::Random *rand;
+    ColumnarDataStore *columnarData;
+    NearestNeighborSearch::Types nnSearch;
+    const NearestNeighborCache *nnCache;
+
+    void insert( CoveredPoint *const p );
+    void reset();
+    void release_pool();
+
+    bool less_covered( const int &a, const int &b ) const {
+        double coverage_a = coverage[pcPositions[a]];
+        double coverage_b = coverage[pcPositions[b]];
+        return coverage_a < coverage_b || 
+               ( coverage_a == coverage_b && a < b );
+    }
+
+    void place_in_heap( const size_t &position, const int &point );
+    void sift_up( size_t position );
+    void sift_down( size_t position );
+
+    bool find_nn_cached();
+    void find_nn_tree();
+    void find_nn_blocked( util::ThreadPool *thread_pool );
+    void find_nn_approximate( util::ThreadPool *thread_pool );
 
     TrainingData(const TrainingData&) = delete;
     TrainingData& operator=(const TrainingData&) = delete;
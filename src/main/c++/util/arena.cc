@@ -0,0 +1,66 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "util/arena.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace util {
+
+using std::vector;
+
+Arena::Arena( const size_t &block_size ) : blockSize(block_size), blocks(),
+                                           next(0), limit(0), capacity(0) {}
+
+Arena::~Arena() {
+    release();
+}
+
+void* Arena::allocate( const size_t &size, const size_t &alignment ) {
+    uintptr_t mask = static_cast<uintptr_t>(alignment - 1);
+    uintptr_t address = (reinterpret_cast<uintptr_t>(next) + mask) & ~mask;
+
+    if ( next == 0 || address + size > reinterpret_cast<uintptr_t>(limit) ) {
+        // Oversized requests get a block of their own
+        size_t length = size + alignment;
+        if ( length < blockSize ) length = blockSize;
+
+        char *block = new char[length];
+        blocks.push_back( block );
+        capacity += length;
+
+        next = block;
+        limit = block + length;
+        address = (reinterpret_cast<uintptr_t>(next) + mask) & ~mask;
+    }
+
+    next = reinterpret_cast<char*>( address + size );
+    return reinterpret_cast<void*>( address );
+}
+
+void Arena::release() {
+    vector<char*>::iterator bit;
+    for ( bit = blocks.begin(); bit != blocks.end(); ++bit ) {
+        delete[] *bit;
+    }
+    blocks.clear();
+    next = 0;
+    limit = 0;
+    capacity = 0;
+}
+
+}  // namespace util
@@ -0,0 +1,73 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef UTIL_ARENA_H
+#define UTIL_ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+namespace util {
+
+/*
+ * A simple region (arena) allocator. Memory is carved out of large blocks
+ * and is only released all at once, when the arena is released or
+ * destroyed. Objects constructed in an arena's memory must therefore not
+ * own resources which need their destructors to run.
+ *
+ * An arena is not thread safe.
+ */
+class Arena {
+ public:
+    /*
+     * Creates an arena which allocates blocks of the specified size.
+     */
+    explicit Arena( const size_t &block_size = 1 << 20 );
+
+    virtual ~Arena();
+
+    /*
+     * Allocates the specified number of bytes aligned on the specified
+     * boundary, which must be a power of two.
+     */
+    void* allocate( const size_t &size, const size_t &alignment = 16 );
+
+    /*
+     * Frees all memory allocated from this arena.
+     */
+    void release();
+
+    /*
+     * Retrieve the total number of bytes held by this arena.
+     */
+    size_t get_capacity() const {
+        return capacity;
+    }
+
+ private:
+    size_t blockSize;
+    std::vector<char*> blocks;
+    char *next;
+    char *limit;
+    size_t capacity;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+};
+
+}  // namespace util
+
+#endif  // UTIL_ARENA_H
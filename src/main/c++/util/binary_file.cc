@@ -0,0 +1,124 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "util/binary_file.h"
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "util/io_error.h"
+
+namespace util {
+
+using std::string;
+using std::vector;
+
+namespace {
+
+// The alignment of every block of a binary file
+const size_t ALIGNMENT = 8;
+
+size_t padding( const size_t &size ) {
+    return (ALIGNMENT - size % ALIGNMENT) % ALIGNMENT;
+}
+
+}  // namespace
+
+BinaryWriter::BinaryWriter( const string &filename ) : filename(filename),
+                                                       file(0), offset(0) {
+    file = fopen( filename.c_str(), "wb" );
+    int errsv = errno;
+
+    if ( file == NULL ) {
+        string msg = "ERROR: " + string(strerror(errsv)) + " '" 
+                                            + filename + "'";
+        throw IOError(__FILE__, __LINE__, msg );
+    }
+}
+
+BinaryWriter::~BinaryWriter() {
+    if ( file != NULL ) fclose( file );
+}
+
+void BinaryWriter::write( const void *data, const size_t &size ) {
+    static const char zeros[ALIGNMENT] = { 0 };
+
+    size_t pad = padding( size );
+    if ( fwrite( data, 1, size, file ) != size ||
+         fwrite( zeros, 1, pad, file ) != pad ) {
+        throw IOError(__FILE__, __LINE__, 
+                      "ERROR: failed to write '" + filename + "'" );
+    }
+    offset += size + pad;
+}
+
+void BinaryWriter::write_string( const string &value ) {
+    write_int( static_cast<int64_t>(value.size()) );
+    write( value.data(), value.size() );
+}
+
+void BinaryWriter::close() {
+    int status = fclose( file );
+    file = NULL;
+    if ( status != 0 ) {
+        throw IOError(__FILE__, __LINE__, 
+                      "ERROR: failed to write '" + filename + "'" );
+    }
+}
+
+BinaryReader::BinaryReader( const string &filename ) : filename(filename),
+                                                       file(0), offset(0) {
+    file = fopen( filename.c_str(), "rb" );
+    int errsv = errno;
+
+    if ( file == NULL ) {
+        string msg = "ERROR: " + string(strerror(errsv)) + " '" 
+                                            + filename + "'";
+        throw IOError(__FILE__, __LINE__, msg );
+    }
+}
+
+BinaryReader::~BinaryReader() {
+    fclose( file );
+}
+
+void BinaryReader::read( void *data, const size_t &size ) {
+    char skipped[ALIGNMENT];
+
+    size_t pad = padding( size );
+    if ( fread( data, 1, size, file ) != size ||
+         fread( skipped, 1, pad, file ) != pad ) {
+        throw IOError(__FILE__, __LINE__, 
+                      "ERROR: unexpected end of '" + filename + "'" );
+    }
+    offset += size + pad;
+}
+
+string BinaryReader::read_string() {
+    int64_t size = read_int();
+    if ( size < 0 ) {
+        throw IOError(__FILE__, __LINE__, 
+                      "ERROR: corrupt string in '" + filename + "'" );
+    }
+
+    vector<char> characters( size );
+    read( characters.data(), characters.size() );
+    return string( characters.begin(), characters.end() );
+}
+
+}   // namespace util
@@ -0,0 +1,145 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef UTIL_BINARY_FILE_H
+#define UTIL_BINARY_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace util {
+
+/*
+ * A BinaryWriter writes blocks of bytes to a binary file, in the byte order
+ * of the machine. Every block is padded to a multiple of eight bytes, so
+ * that a block of 64 bit values always starts on an eight byte boundary of
+ * the file, and so of any mapping of the file into memory.
+ */
+class BinaryWriter {
+ public:
+    /*
+     * Creates the specified file, replacing any existing one.
+     */
+    explicit BinaryWriter( const std::string &filename );
+
+    virtual ~BinaryWriter();
+
+    /*
+     * Writes the specified number of bytes, followed by the padding.
+     */
+    void write( const void *data, const size_t &size );
+
+    /*
+     * Writes a 64 bit integer.
+     */
+    void write_int( const int64_t &value ) {
+        write( &value, sizeof(value) );
+    }
+
+    /*
+     * Writes a double.
+     */
+    void write_double( const double &value ) {
+        write( &value, sizeof(value) );
+    }
+
+    /*
+     * Writes a string as its length followed by its characters.
+     */
+    void write_string( const std::string &value );
+
+    /*
+     * Retrieves the number of bytes written so far.
+     */
+    size_t get_offset() const {
+        return offset;
+    }
+
+    /*
+     * Flushes and closes the file.
+     */
+    void close();
+
+ private:
+    std::string filename;
+    FILE *file;
+    size_t offset;
+
+    BinaryWriter(const BinaryWriter&) = delete;
+    BinaryWriter& operator=(const BinaryWriter&) = delete;
+};
+
+/*
+ * A BinaryReader reads the blocks of bytes written by a BinaryWriter.
+ */
+class BinaryReader {
+ public:
+    /*
+     * Opens the specified file.
+     */
+    explicit BinaryReader( const std::string &filename );
+
+    virtual ~BinaryReader();
+
+    /*
+     * Reads the specified number of bytes and skips the padding.
+     */
+    void read( void *data, const size_t &size );
+
+    /*
+     * Reads a 64 bit integer.
+     */
+    int64_t read_int() {
+        int64_t value;
+        read( &value, sizeof(value) );
+        return value;
+    }
+
+    /*
+     * Reads a double.
+     */
+    double read_double() {
+        double value;
+        read( &value, sizeof(value) );
+        return value;
+    }
+
+    /*
+     * Reads a string written by BinaryWriter::write_string.
+     */
+    std::string read_string();
+
+    /*
+     * Retrieves the number of bytes read so far.
+     */
+    size_t get_offset() const {
+        return offset;
+    }
+
+ private:
+    std::string filename;
+    FILE *file;
+    size_t offset;
+
+    BinaryReader(const BinaryReader&) = delete;
+    BinaryReader& operator=(const BinaryReader&) = delete;
+};
+
+}   // namespace util
+
+#endif   // UTIL_BINARY_FILE_H
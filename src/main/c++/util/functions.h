@@ -58,6 +58,8 @@ static std::stringstream converter__;
 */
 template <typename Target> 
 inline void to_numeric(std::string const &s, Target &value) {
+    // Drop whatever a failed conversion left unread
+    numeric_interpreter__.str( std::string() );
     numeric_interpreter__.clear();
 
     numeric_interpreter__ << s;
@@ -0,0 +1,69 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "util/mapped_file.h"
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util/io_error.h"
+
+namespace util {
+
+using std::string;
+
+MappedFile::MappedFile( const string &filename ) : data(0), size(0) {
+    int fd = open( filename.c_str(), O_RDONLY );
+    if ( fd < 0 ) {
+        int errsv = errno;
+        string msg = "ERROR: " + string(strerror(errsv)) + " '" 
+                                            + filename + "'";
+        throw IOError(__FILE__, __LINE__, msg );
+    }
+
+    struct stat status;
+    if ( fstat( fd, &status ) != 0 || status.st_size == 0 ) {
+        close( fd );
+        throw IOError(__FILE__, __LINE__, 
+                      "ERROR: cannot map empty or unreadable '" + 
+                      filename + "'" );
+    }
+    size = static_cast<size_t>( status.st_size );
+
+    // The mapping stays valid after the file is closed
+    void *mapping = mmap( 0, size, PROT_READ, MAP_SHARED, fd, 0 );
+    int errsv = errno;
+    close( fd );
+
+    if ( mapping == MAP_FAILED ) {
+        string msg = "ERROR: " + string(strerror(errsv)) + " '" 
+                                            + filename + "'";
+        throw IOError(__FILE__, __LINE__, msg );
+    }
+    data = static_cast<const char*>( mapping );
+}
+
+MappedFile::~MappedFile() {
+    munmap( const_cast<char*>( data ), size );
+}
+
+}   // namespace util
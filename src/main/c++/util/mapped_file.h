@@ -0,0 +1,64 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef UTIL_MAPPED_FILE_H
+#define UTIL_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace util {
+
+/*
+ * A MappedFile maps a whole file read-only into memory. The pages are
+ * shared with every other process which maps the same file, and are only
+ * read from the file as they are touched. The mapping starts on a page
+ * boundary, so data aligned within the file is aligned in memory, too.
+ */
+class MappedFile {
+ public:
+    /*
+     * Maps the specified file, which must not be empty.
+     */
+    explicit MappedFile( const std::string &filename );
+
+    virtual ~MappedFile();
+
+    /*
+     * Retrieves the start of the mapped file.
+     */
+    const char* get_data() const {
+        return data;
+    }
+
+    /*
+     * Retrieves the size of the mapped file in bytes.
+     */
+    size_t get_size() const {
+        return size;
+    }
+
+ private:
+    const char *data;
+    size_t size;
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+}   // namespace util
+
+#endif   // UTIL_MAPPED_FILE_H
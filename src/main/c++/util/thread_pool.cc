@@ -0,0 +1,194 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "util/thread_pool.h"
+
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+using std::exception_ptr;
+using std::lock_guard;
+using std::mutex;
+using std::thread;
+using std::unique_lock;
+using std::vector;
+
+// The pool and queue served by the current thread, if it is a worker
+static thread_local const ThreadPool *worker_pool = 0;
+static thread_local int worker_index = -1;
+
+ThreadPool::ThreadPool( const int &num_threads ) : numThreads(num_threads),
+                        queues(), workers(), numQueued(0), nextQueue(0),
+                        sleepMutex(), wakeUp(), stopping(false) {
+
+    if ( numThreads < 1 ) {
+        numThreads = static_cast<int>( thread::hardware_concurrency() );
+        if ( numThreads < 1 ) numThreads = 1;
+    }
+
+    int num_workers = numThreads - 1;
+    int num_queues = num_workers > 0 ? num_workers : 1;
+    for ( int q = 0; q < num_queues; ++q ) {
+        queues.push_back( new Queue() );
+    }
+
+    for ( int w = 0; w < num_workers; ++w ) {
+        workers.push_back( thread( &ThreadPool::work, this, w ) );
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock( sleepMutex );
+        stopping = true;
+    }
+    wakeUp.notify_all();
+
+    vector<thread>::iterator wit;
+    for ( wit = workers.begin(); wit != workers.end(); ++wit ) {
+        wit->join();
+    }
+
+    vector<Queue*>::iterator qit;
+    for ( qit = queues.begin(); qit != queues.end(); ++qit ) {
+        delete *qit;
+    }
+}
+
+int ThreadPool::current_index() const {
+    return worker_pool == this ? worker_index : -1;
+}
+
+void ThreadPool::submit( TaskGroup &group, const Task &task ) {
+    Item item;
+    item.task = task;
+    item.group = &group;
+
+    ++group.pending;
+
+    // Workers push onto their own queue, other threads distribute their
+    // tasks over all queues.
+    int index = current_index();
+    if ( index < 0 ) {
+        index = static_cast<int>( nextQueue++ % queues.size() );
+    }
+
+    {
+        lock_guard<mutex> lock( queues[index]->mutex );
+        queues[index]->items.push_back( item );
+    }
+
+    {
+        lock_guard<mutex> lock( sleepMutex );
+        ++numQueued;
+    }
+    wakeUp.notify_one();
+}
+
+void ThreadPool::wait( TaskGroup &group ) {
+    int index = current_index();
+
+    while ( group.pending.load() > 0 ) {
+        if ( run_one( index ) ) continue;
+
+        unique_lock<mutex> lock( sleepMutex );
+        wakeUp.wait( lock, [this, &group] () {
+            return group.pending.load() == 0 || numQueued.load() > 0;
+        });
+    }
+
+    if ( group.error ) {
+        exception_ptr error = group.error;
+        group.error = exception_ptr();
+        std::rethrow_exception( error );
+    }
+}
+
+void ThreadPool::work( const int &index ) {
+    worker_pool = this;
+    worker_index = index;
+
+    while ( true ) {
+        if ( run_one( index ) ) continue;
+
+        unique_lock<mutex> lock( sleepMutex );
+        wakeUp.wait( lock, [this] () {
+            return stopping || numQueued.load() > 0;
+        });
+        if ( stopping && numQueued.load() == 0 ) break;
+    }
+}
+
+bool ThreadPool::run_one( const int &index ) {
+    Item item;
+    if ( !take( index, item ) ) return false;
+
+    try {
+        item.task();
+    } catch (...) {
+        lock_guard<mutex> lock( item.group->errorMutex );
+        if ( !item.group->error ) item.group->error = std::current_exception();
+    }
+
+    finish( *item.group );
+    return true;
+}
+
+bool ThreadPool::take( const int &index, Item &item ) {
+    if ( numQueued.load() == 0 ) return false;
+
+    int num_queues = static_cast<int>( queues.size() );
+
+    // First look at the back of our own queue ...
+    if ( index >= 0 ) {
+        Queue *own = queues[index];
+        lock_guard<mutex> lock( own->mutex );
+        if ( !own->items.empty() ) {
+            item = own->items.back();
+            own->items.pop_back();
+            --numQueued;
+            return true;
+        }
+    }
+
+    // ... then try to steal from the front of the other queues.
+    int start = index >= 0 ? index + 1 : 0;
+    for ( int q = 0; q < num_queues; ++q ) {
+        Queue *victim = queues[(start + q) % num_queues];
+        lock_guard<mutex> lock( victim->mutex );
+        if ( !victim->items.empty() ) {
+            item = victim->items.front();
+            victim->items.pop_front();
+            --numQueued;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::finish( TaskGroup &group ) {
+    if ( --group.pending == 0 ) {
+        lock_guard<mutex> lock( sleepMutex );
+        wakeUp.notify_all();
+    }
+}
+
+}  // namespace util
@@ -0,0 +1,158 @@
+/*
+ *  Copyright 2011 The Stochastico Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef UTIL_THREAD_POOL_H
+#define UTIL_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+/*
+ * A persistent pool of worker threads executing tasks with work stealing.
+ *
+ * Every worker owns a double ended queue of tasks. A worker takes its own
+ * tasks from the back of its queue and, when that is empty, steals tasks from
+ * the front of the other workers' queues. Tasks are collected in TaskGroups;
+ * a thread waiting on a TaskGroup helps executing pending tasks, so tasks may
+ * themselves submit and wait on further tasks without dead-locking the pool.
+ *
+ * A pool created for N threads starts N-1 workers, the N-th thread being the
+ * one that waits. A pool for a single thread therefore executes all of its
+ * tasks on the waiting thread.
+ */
+class ThreadPool {
+ public:
+    typedef std::function<void()> Task;
+
+    /*
+     * A set of related tasks which can be waited upon as a whole.
+     */
+    class TaskGroup {
+     public:
+        TaskGroup() : pending(0), error() {}
+
+        virtual ~TaskGroup() {}
+
+     private:
+        friend class ThreadPool;
+
+        std::atomic<int> pending;
+        std::exception_ptr error;
+        std::mutex errorMutex;
+
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+    };
+
+    /*
+     * Creates a pool for the specified number of threads. If the number of
+     * threads is less than 1 the number of hardware threads is used.
+     */
+    explicit ThreadPool( const int &num_threads = 0 );
+
+    virtual ~ThreadPool();
+
+    /*
+     * Retrieve the number of threads executing the tasks of this pool.
+     */
+    int size() const {
+        return numThreads;
+    }
+
+    /*
+     * Schedule the specified task as a member of the specified group.
+     */
+    void submit( TaskGroup &group, const Task &task );
+
+    /*
+     * Wait until all tasks of the specified group have finished. The calling
+     * thread executes pending tasks while it waits. If any of the group's
+     * tasks threw an exception, the first such exception is rethrown here.
+     */
+    void wait( TaskGroup &group );
+
+    /*
+     * Apply the specified function to the range [first,last) split into
+     * blocks of at most grain elements. The function is called as
+     * function(begin, end) for each block, possibly in parallel, and this
+     * method returns once all blocks have been processed.
+     */
+    template <typename Function>
+    void parallel_for( const size_t &first, const size_t &last,
+                       const size_t &grain, const Function &function );
+
+ private:
+    struct Item {
+        Task task;
+        TaskGroup *group;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Item> items;
+    };
+
+    int numThreads;
+    std::vector<Queue*> queues;
+    std::vector<std::thread> workers;
+    std::atomic<int> numQueued;
+    std::atomic<unsigned> nextQueue;
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    bool stopping;
+
+    void work( const int &index );
+    bool run_one( const int &index );
+    bool take( const int &index, Item &item );
+    void finish( TaskGroup &group );
+    int current_index() const;
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+};
+
+template <typename Function>
+void ThreadPool::parallel_for( const size_t &first, const size_t &last,
+                               const size_t &grain, const Function &function ){
+    if ( last <= first ) return;
+
+    size_t block = grain > 0 ? grain : 1;
+
+    if ( numThreads < 2 || last - first <= block ) {
+        function( first, last );
+        return;
+    }
+
+    TaskGroup group;
+    for ( size_t begin = first; begin < last; begin += block ) {
+        size_t end = begin + block < last ? begin + block : last;
+        submit( group, [&function, begin, end] () { function(begin, end); } );
+    }
+    wait( group );
+}
+
+}  // namespace util
+
+#endif  // UTIL_THREAD_POOL_H
@@ -15,24 +15,81 @@
  *
  */
 
+#include <algorithm>
+#include <cstring>
 #include <new>
 #include <string>
+#include <utility>
 #include <limits>
+#include <vector>
 
 #include <fenv.h>
 #include <math.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
+#include <noir/ball.h>
+#include <noir/hnsw_graph.h>
+#include <noir/noir_space.h>
+#include <noir/orthotope.h>
+#include <noir/point.h>
+#include <noir/point_columns.h>
+#include <noir/vp_tree.h>
 #include <rng/random.h>
 #include <rng/ranmar.h>
 #include <rng/mt19937.h>
 #include <rng/zran.h>
+#include <sdm/ball_model.h>
+#include <sdm/compiled_discriminator.h>
+#include <sdm/covered_point.h>
+#include <sdm/data_manager.h>
+#include <sdm/data_point.h>
+#include <sdm/data_store.h>
+#include <sdm/discriminator.h>
+#include <sdm/discriminator_view.h>
+#include <sdm/nearest_neighbor_cache.h>
+#include <sdm/orthotope_model.h>
+#include <sdm/sdmachine.h>
+#include <sdm/training_data.h>
+#include <util/binary_file.h>
 #include <util/timer.h>
 #include <util/functions.h>
+#include <util/invalid_input_error.h>
+#include <util/mapped_file.h>
+#include <util/properties.h>
+#include <util/thread_pool.h>
 
+using noir::Ball;
+using noir::HNSWGraph;
+using noir::NoirSpace;
+using noir::Orthotope;
+using noir::Point;
+using noir::PointColumns;
+using noir::VPTree;
 using rng::Random;
 using rng::Ranmar;
 using rng::MTwist;
 using rng::Zran;
+using sdm::BallModelFactory;
+using sdm::CompiledDiscriminator;
+using sdm::CoveredPoint;
+using sdm::DataManager;
+using sdm::DataPoint;
+using sdm::DataStore;
+using sdm::Discriminator;
+using sdm::DiscriminatorView;
+using sdm::Model;
+using sdm::ModelFactory;
+using sdm::NearestNeighborCache;
+using sdm::NearestNeighborSearch;
+using sdm::OrthotopeModelFactory;
+using sdm::SDMachine;
+using sdm::TrainingData;
+using util::BinaryReader;
+using util::BinaryWriter;
+using util::MappedFile;
+using util::Properties;
+using util::ThreadPool;
 using util::Timer;
 using util::to_numeric;
 
@@ -159,6 +216,1425 @@ void test_to_numeric() {
     } catch (util::NumberFormatError nfe ) {
         fprintf(stdout,"Test to_numeric partial string:  [passed]\n");
     }
+
+    // The input a failed conversion left unread must not be prepended to
+    // the next value converted
+    double doubleD = 0.0;
+    try {
+        to_numeric("2.5", doubleD);
+    } catch (util::NumberFormatError &nfe ) {
+    }
+    if ( doubleD == 2.5 ) {
+        fprintf(stdout,"Test to_numeric after failure:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test to_numeric after failure:  [failed]  %16.7f\n", 
+                                doubleD);
+    }
+}
+
+void test_thread_pool() {
+    const int num_tasks = 64;
+    const size_t num_elements = 100000;
+
+    ThreadPool pool( 4 );
+
+    // Tasks which submit and wait on nested tasks must not dead-lock
+    std::vector<long> sums( num_tasks, 0 );
+    ThreadPool::TaskGroup group;
+    for ( int t = 0; t < num_tasks; ++t ) {
+        pool.submit( group, [&pool, &sums, t, num_elements] () {
+            std::vector<long> partial( num_elements, 0 );
+            pool.parallel_for( 0, num_elements, 1000,
+                               [&partial, t] ( size_t begin, size_t end ) {
+                for ( size_t e = begin; e < end; ++e ) {
+                    partial[e] = static_cast<long>(e) + t;
+                }
+            });
+            long sum = 0;
+            for ( size_t e = 0; e < num_elements; ++e ) sum += partial[e];
+            sums[t] = sum;
+        });
+    }
+    pool.wait( group );
+
+    bool passed = true;
+    long expected = static_cast<long>(num_elements)*(num_elements - 1)/2;
+    for ( int t = 0; t < num_tasks; ++t ) {
+        if ( sums[t] != expected + t*static_cast<long>(num_elements) ) {
+            passed = false;
+        }
+    }
+
+    // Exceptions thrown by a task are passed on to the waiting thread
+    ThreadPool::TaskGroup failing;
+    pool.submit( failing, [] () {
+        throw util::NumberFormatError( __FILE__, __LINE__, "x", "int" );
+    });
+    try {
+        pool.wait( failing );
+        passed = false;
+    } catch ( util::NumberFormatError &nfe ) {
+    }
+
+    if ( passed ) {
+        fprintf(stdout,"Test ThreadPool:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test ThreadPool:  [failed]\n");
+    }
+}
+
+void test_point_columns() {
+    const int num_points = 1000;
+
+    NoirSpace space( 2, 1, 1, 3 );
+    Random *random = new MTwist( 4357 );
+
+    // Random points, about one in ten coordinates missing
+    std::vector<Point*> points;
+    PointColumns columns( &space );
+    for ( int p = 0; p < num_points; ++p ) {
+        Point *point = new Point( &space );
+        for ( int n = 0; n < space.nominal; ++n ) {
+            int value = random->next_int( 4 );
+            if ( random->next() < 0.1 ) value = -1;
+            point->set_nominal_coordinate( n, value );
+        }
+        for ( int o = 0; o < space.ordinal; ++o ) {
+            double value = 0.1*random->next_int( 10 );
+            if ( random->next() < 0.1 ) value = -1;
+            point->set_ordinal_coordinate( o, value );
+        }
+        for ( int i = 0; i < space.interval; ++i ) {
+            double value = random->next();
+            if ( random->next() < 0.1 ) value = NAN;
+            point->set_interval_coordinate( i, value );
+        }
+        for ( int r = 0; r < space.real; ++r ) {
+            double value = random->next();
+            if ( random->next() < 0.1 ) value = NAN;
+            point->set_real_coordinate( r, value );
+        }
+        points.push_back( point );
+        columns.add( point );
+    }
+
+    Orthotope orthotope( &space );
+    orthotope.add_nominal( 0, 1 );
+    orthotope.add_nominal( 0, 2 );
+    orthotope.add_nominal( 1, 0 );
+    orthotope.add_nominal( 1, 3 );
+    orthotope.set_ordinal_boundaries( 0, 0.2, 0.7 );
+    orthotope.set_interval_boundaries( 0, 0.8, 0.3 );
+    for ( int r = 0; r < space.real; ++r ) {
+        orthotope.set_real_boundaries( r, 0.1, 0.9 );
+    }
+
+    Ball ball( &space, 1.5 );
+    ball.add_nominal( 0, 2 );
+    for ( int r = 0; r < space.real; ++r ) {
+        ball.set_real_coordinate( r, 0.5 );
+    }
+    ball.set_interval_coordinate( 0, 0.9 );
+    ball.set_ordinal_coordinate( 0, 0.5 );
+
+    // The columnar kernels must agree with the point-wise ones
+    bool passed = true;
+    const size_t begin = 17;
+    const size_t end = num_points;
+    std::vector<char> in_orthotope( end - begin );
+    std::vector<char> in_ball( end - begin );
+    std::vector<double> dist( end - begin );
+    orthotope.in_closure( columns, begin, end, &in_orthotope[0] );
+    ball.in_closure( columns, begin, end, &in_ball[0] );
+    space.norm( &ball, columns, begin, end, &dist[0] );
+    for ( size_t p = begin; p < end; ++p ) {
+        if ( (in_orthotope[p - begin] != 0) != 
+                                    orthotope.in_closure( points[p] ) ||
+             (in_ball[p - begin] != 0) != ball.in_closure( points[p] ) ||
+             dist[p - begin] != space.norm( &ball, points[p] ) ) {
+            passed = false;
+        }
+    }
+
+    // The norm, computed from the products of the precomputed sines and
+    // cosines, must agree closely with libm sin(M_PI*(x-y))
+    for ( size_t p = 0; p + 1 < points.size(); ++p ) {
+        double x = points[p]->get_interval_coordinate( 0 );
+        double y = points[p + 1]->get_interval_coordinate( 0 );
+        if ( isnan(x) || isnan(y) ) continue;
+        Point *px = new Point( &space );
+        Point *py = new Point( &space );
+        px->set_interval_coordinate( 0, x );
+        py->set_interval_coordinate( 0, y );
+        double expected = fabs( sin( M_PI*(x - y) ) );
+        if ( fabs( space.norm( px, py ) - expected ) > 1.0e-14 ) {
+            passed = false;
+        }
+        delete px;
+        delete py;
+    }
+
+    // Nominal values beyond the first word of the masks
+    orthotope.add_nominal( 0, 70 );
+    if ( !orthotope.allows_nominal( 0, 70 ) ||
+         !orthotope.allows_nominal( 0, 1 ) ||
+         orthotope.allows_nominal( 0, 3 ) ||
+         orthotope.get_num_nominals( 0 ) != 3 ) {
+        passed = false;
+    }
+
+    if ( passed ) {
+        fprintf(stdout,"Test PointColumns:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test PointColumns:  [failed]\n");
+    }
+
+    for ( int p = 0; p < num_points; ++p ) {
+        delete points[p];
+    }
+    delete random;
+}
+
+void test_norm_symmetry() {
+    const int num_points = 2000;
+
+    NoirSpace space( 1, 1, 3, 2 );
+    Random *random = new MTwist( 4357 );
+
+    // Random points dominated by interval coordinates, some of them missing
+    std::vector<Point*> points;
+    PointColumns columns( &space );
+    for ( int p = 0; p < num_points; ++p ) {
+        Point *point = new Point( &space );
+        point->set_nominal_coordinate( 0, random->next_int( 3 ) );
+        point->set_ordinal_coordinate( 0, 0.1*random->next_int( 10 ) );
+        for ( int i = 0; i < space.interval; ++i ) {
+            double value = random->next();
+            if ( random->next() < 0.05 ) value = NAN;
+            point->set_interval_coordinate( i, value );
+        }
+        for ( int r = 0; r < space.real; ++r ) {
+            point->set_real_coordinate( r, random->next() );
+        }
+        points.push_back( point );
+        columns.add( point );
+    }
+
+    // The norm must be symmetric and vanish for identical points, in the
+    // point-wise and in the columnar form
+    bool passed = true;
+    std::vector<double> dist( num_points );
+    for ( int p = 0; p < num_points; ++p ) {
+        Point *x = points[p];
+        Point *y = points[(p + 1) % num_points];
+        if ( space.norm( x, y ) != space.norm( y, x ) ||
+             space.norm( x, x ) != 0.0 ) {
+            passed = false;
+        }
+    }
+    for ( int p = 0; p < num_points; p += 97 ) {
+        space.norm( points[p], columns, 0, num_points, &dist[0] );
+        if ( dist[p] != 0.0 ) passed = false;
+        for ( int q = 0; q < num_points; ++q ) {
+            if ( dist[q] != space.norm( points[q], points[p] ) ) {
+                passed = false;
+            }
+        }
+    }
+
+    if ( passed ) {
+        fprintf(stdout,"Test norm symmetry:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test norm symmetry:  [failed]\n");
+    }
+
+    for ( int p = 0; p < num_points; ++p ) {
+        delete points[p];
+    }
+    delete random;
+}
+
+void test_vp_tree() {
+    const int num_points = 2000;
+
+    NoirSpace space( 2, 1, 1, 3 );
+    Random *random = new MTwist( 4357 );
+
+    // Random complete points on a coarse grid, so that ties occur
+    std::vector<Point*> points;
+    std::vector<const Point*> tree_points;
+    for ( int p = 0; p < num_points; ++p ) {
+        Point *point = new Point( &space );
+        for ( int n = 0; n < space.nominal; ++n ) {
+            point->set_nominal_coordinate( n, random->next_int( 3 ) );
+        }
+        for ( int o = 0; o < space.ordinal; ++o ) {
+            point->set_ordinal_coordinate( o, 0.1*random->next_int( 10 ) );
+        }
+        for ( int i = 0; i < space.interval; ++i ) {
+            point->set_interval_coordinate( i, 0.1*random->next_int( 10 ) );
+        }
+        for ( int r = 0; r < space.real; ++r ) {
+            point->set_real_coordinate( r, 0.1*random->next_int( 10 ) );
+        }
+        points.push_back( point );
+        tree_points.push_back( point );
+    }
+
+    // The tree must find the same neighbour as a linear scan
+    bool passed = true;
+    VPTree tree( tree_points );
+    for ( int q = 0; q < num_points; ++q ) {
+        int expected = -1;
+        double expected_dist = std::numeric_limits<double>::max();
+        for ( int p = 0; p < num_points; ++p ) {
+            if ( p == q ) continue;
+            double d = space.norm( points[q], points[p] );
+            if ( d < expected_dist ) {
+                expected = p;
+                expected_dist = d;
+            }
+        }
+        double dist = 0.0;
+        if ( tree.nearest( points[q], q, dist ) != expected ||
+             dist != expected_dist ) {
+            passed = false;
+        }
+    }
+
+    // The k nearest neighbours must be the first k of a sorted scan
+    const size_t k = 5;
+    for ( int q = 0; q < num_points; q += 7 ) {
+        std::vector<std::pair<double,int> > scan;
+        for ( int p = 0; p < num_points; ++p ) {
+            if ( p == q ) continue;
+            scan.push_back( std::make_pair( space.norm( points[q], points[p] ),
+                                            p ) );
+        }
+        std::sort( scan.begin(), scan.end() );
+        std::vector<int> neighbors;
+        std::vector<double> dists;
+        tree.nearest( points[q], q, k, neighbors, dists );
+        if ( neighbors.size() != k ) passed = false;
+        for ( size_t m = 0; m < neighbors.size() && m < k; ++m ) {
+            if ( neighbors[m] != scan[m].second || 
+                 dists[m] != scan[m].first ) {
+                passed = false;
+            }
+        }
+    }
+
+    Point *incomplete = new Point( &space );
+    incomplete->set_real_coordinate( 0, NAN );
+    if ( !VPTree::is_complete( points[0] ) || 
+         VPTree::is_complete( incomplete ) ) {
+        passed = false;
+    }
+    delete incomplete;
+
+    if ( passed ) {
+        fprintf(stdout,"Test VPTree:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test VPTree:  [failed]\n");
+    }
+
+    for ( int p = 0; p < num_points; ++p ) {
+        delete points[p];
+    }
+    delete random;
+}
+
+void test_nearest_neighbors() {
+    const int num_points = 2400;
+
+    // Nominal coordinates dominate, so the tiled search over all pairs is
+    // used; the principal color points make up an odd number of tiles
+    NoirSpace space( 6, 1, 0, 1 );
+    Random *random = new MTwist( 4357 );
+
+    std::vector<DataPoint*> points;
+    TrainingData training_data( 0 );
+    for ( int p = 0; p < num_points; ++p ) {
+        DataPoint *point = new DataPoint( p, p % 2, &space );
+        for ( int n = 0; n < space.nominal; ++n ) {
+            point->set_nominal_coordinate( n, random->next_int( 3 ) );
+        }
+        point->set_ordinal_coordinate( 0, 0.1*random->next_int( 10 ) );
+        double value = 0.1*random->next_int( 10 );
+        if ( random->next() < 0.1 ) value = NAN;
+        point->set_real_coordinate( 0, value );
+        points.push_back( point );
+        training_data.add( new CoveredPoint( point ) );
+    }
+
+    ThreadPool pool( 4 );
+    training_data.find_nn( &pool );
+
+    // The nearest neighbours must be those found by a linear scan
+    bool passed = true;
+    std::vector<CoveredPoint*> principal;
+    for ( int p = 0; p < num_points; ++p ) {
+        if ( training_data[p]->get_color() == 0 ) {
+            principal.push_back( training_data[p] );
+        }
+    }
+    for ( size_t q = 0; q < principal.size(); ++q ) {
+        CoveredPoint *expected = 0;
+        double expected_dist = std::numeric_limits<double>::max();
+        for ( size_t p = 0; p < principal.size(); ++p ) {
+            if ( p == q ) continue;
+            double d = space.norm( principal[q]->get_data_point(), 
+                                   principal[p]->get_data_point() );
+            if ( d < expected_dist ) {
+                expected = principal[p];
+                expected_dist = d;
+            }
+        }
+        if ( training_data.get_nn( principal[q] ) != expected ) {
+            passed = false;
+        }
+    }
+
+    if ( passed ) {
+        fprintf(stdout,"Test nearest neighbors:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test nearest neighbors:  [failed]\n");
+    }
+
+    training_data.clear();
+    for ( int p = 0; p < num_points; ++p ) {
+        delete points[p];
+    }
+    delete random;
+}
+
+void test_nn_cache() {
+    const int num_points = 600;
+    const int num_folds = 10;
+    const int num_neighbors = 2;
+
+    NoirSpace space( 1, 0, 0, 2 );
+    Random *random = new MTwist( 4357 );
+
+    // Points of color 0 at few distinct positions, so that many of them are
+    // duplicates, and three points of color 1, fewer than the neighbours
+    // cached for them, spread at random over the folds
+    std::vector<DataPoint*> points;
+    std::vector<DataStore*> folds;
+    std::vector<int> fold_of;
+    for ( int f = 0; f < num_folds; ++f ) {
+        folds.push_back( new DataStore() );
+    }
+    for ( int p = 0; p < num_points + 3; ++p ) {
+        DataPoint *point = new DataPoint( p, p < num_points ? 0 : 1, &space );
+        int position = random->next_int( 200 );
+        point->set_nominal_coordinate( 0, position % 3 );
+        point->set_real_coordinate( 0, 0.01*(position % 17) );
+        point->set_real_coordinate( 1, random->next() < 0.05 ? NAN : 
+                                                        0.001*position );
+        points.push_back( point );
+        fold_of.push_back( random->next_int( num_folds ) );
+        folds[fold_of.back()]->add( point );
+    }
+
+    // Each fold's nearest neighbours taken from the cache must be those
+    // found without it
+    ThreadPool pool( 4 );
+    bool passed = true;
+    int num_fallbacks = 0;
+    for ( int color = 0; color < 2; ++color ) {
+        const int k = color == 0 ? num_neighbors : 4;
+        NearestNeighborCache cache( folds, color, k, &pool );
+
+        // The points of the color are numbered in the order of the folds
+        std::vector<const DataPoint*> numbered;
+        for ( int f = 0; f < num_folds; ++f ) {
+            DataStore::const_iterator pit;
+            for ( pit = folds[f]->begin(); pit != folds[f]->end(); ++pit ) {
+                if ( (*pit)->get_color() != color ) continue;
+                if ( cache.find( *pit ) != 
+                                    static_cast<int>(numbered.size()) ) {
+                    passed = false;
+                }
+                numbered.push_back( *pit );
+            }
+        }
+        if ( color == 1 && cache.get_neighbors( 0 )[2] != -1 ) {
+            passed = false;
+        }
+
+        for ( int skip_fold = 0; skip_fold < num_folds; ++skip_fold ) {
+            TrainingData cached( color );
+            TrainingData searched( color );
+            cached.set_nn_cache( &cache );
+            cached.select( folds, skip_fold );
+            searched.select( folds, skip_fold );
+            cached.find_nn( &pool );
+            searched.find_nn( &pool );
+
+            for ( size_t i = 0; i < cached.size(); ++i ) {
+                if ( cached[i]->get_color() != color ) continue;
+                CoveredPoint *expected = searched.get_nn( searched[i] );
+                CoveredPoint *found = cached.get_nn( cached[i] );
+                if ( ( expected == 0 ) != ( found == 0 ) ||
+                     ( found != 0 && found->get_data_point() != 
+                                     expected->get_data_point() ) ) {
+                    passed = false;
+                }
+
+                // Count the points whose cached neighbours are all held out
+                const int *neighbors = cache.get_neighbors( 
+                                    cache.find( cached[i]->get_data_point() ) );
+                int held_out = 0;
+                for ( int r = 0; r < k && neighbors[r] >= 0; ++r ) {
+                    if ( fold_of[numbered[neighbors[r]]->get_id()] == 
+                                                            skip_fold ) {
+                        ++held_out;
+                    }
+                }
+                if ( held_out == k ) ++num_fallbacks;
+            }
+        }
+    }
+    if ( num_fallbacks == 0 ) passed = false;
+
+    if ( passed ) {
+        fprintf(stdout,"Test nearest neighbor cache:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test nearest neighbor cache:  [failed]\n");
+    }
+
+    for ( int f = 0; f < num_folds; ++f ) {
+        delete folds[f];
+    }
+    for ( size_t p = 0; p < points.size(); ++p ) {
+        delete points[p];
+    }
+    delete random;
+}
+
+void test_approximate_nn() {
+    const int num_points = 20000;
+
+    NoirSpace space( 2, 1, 1, 3 );
+    Random *random = new MTwist( 4357 );
+
+    // Clustered points, about one in twenty coordinates missing
+    std::vector<DataPoint*> points;
+    TrainingData exact( 0 );
+    TrainingData approximate( 0 );
+    approximate.set_nn_search( NearestNeighborSearch::Approximate );
+    for ( int p = 0; p < num_points; ++p ) {
+        DataPoint *point = new DataPoint( p, p % 4 == 0 ? 1 : 0, &space );
+        double centre = 0.1*random->next_int( 10 );
+        for ( int n = 0; n < space.nominal; ++n ) {
+            int value = random->next_int( 3 );
+            if ( random->next() < 0.05 ) value = -1;
+            point->set_nominal_coordinate( n, value );
+        }
+        for ( int o = 0; o < space.ordinal; ++o ) {
+            point->set_ordinal_coordinate( o, 0.1*random->next_int( 10 ) );
+        }
+        for ( int i = 0; i < space.interval; ++i ) {
+            point->set_interval_coordinate( i, centre + 0.1*random->next() );
+        }
+        for ( int r = 0; r < space.real; ++r ) {
+            double value = centre + 0.1*random->next();
+            if ( random->next() < 0.05 ) value = NAN;
+            point->set_real_coordinate( r, value );
+        }
+        points.push_back( point );
+        exact.add( new CoveredPoint( point ) );
+        approximate.add( new CoveredPoint( point ) );
+    }
+
+    Timer timer;
+    double real = 0.0;
+    double cpu = 0.0;
+    double exact_real = 0.0;
+    double exact_cpu = 0.0;
+    double approximate_real = 0.0;
+    double approximate_cpu = 0.0;
+    timer.elapsed( real, cpu );
+    exact.find_nn();
+    timer.elapsed( exact_real, exact_cpu );
+    approximate.find_nn();
+    timer.elapsed( approximate_real, approximate_cpu );
+
+    // A neighbour counts as found if it is as near as the nearest one
+    int num_queries = 0;
+    int num_found = 0;
+    for ( int p = 0; p < num_points; ++p ) {
+        if ( exact[p]->get_color() != 0 ) continue;
+        const Point *query = exact[p]->get_data_point();
+        CoveredPoint *nearest = exact.get_nn( exact[p] );
+        CoveredPoint *near = approximate.get_nn( approximate[p] );
+        ++num_queries;
+        if ( near != 0 && space.norm( query, near->get_data_point() ) <= 
+                          space.norm( query, nearest->get_data_point() ) ) {
+            ++num_found;
+        }
+    }
+    double recall = static_cast<double>(num_found)/num_queries;
+
+    // The approximate search above includes building the graph, which is
+    // timed apart, with and without threads. The graphs must be the same.
+    std::vector<const Point*> graph_points( points.begin(), points.end() );
+    ThreadPool pool( 4 );
+    double serial_real = 0.0;
+    double serial_cpu = 0.0;
+    double threaded_real = 0.0;
+    double threaded_cpu = 0.0;
+    timer.elapsed( real, cpu );
+    HNSWGraph serial_graph( graph_points );
+    timer.elapsed( serial_real, serial_cpu );
+    HNSWGraph threaded_graph( graph_points, &pool );
+    timer.elapsed( threaded_real, threaded_cpu );
+
+    bool same = true;
+    for ( int p = 0; p < num_points; ++p ) {
+        double serial_dist = 0.0;
+        double threaded_dist = 0.0;
+        if ( serial_graph.nearest( points[p], p, 16, serial_dist ) !=
+             threaded_graph.nearest( points[p], p, 16, threaded_dist ) ||
+             serial_dist != threaded_dist ) {
+            same = false;
+        }
+    }
+
+    fprintf(stdout,"Exact: %10.3f s  Approximate: %10.3f s  Recall: %.4f\n",
+                   exact_real, approximate_real, recall);
+    fprintf(stdout,"Graph build: %10.3f s  With 4 threads: %10.3f s\n",
+                   serial_real, threaded_real);
+    if ( recall >= 0.9 && same ) {
+        fprintf(stdout,"Test approximate nearest neighbors:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test approximate nearest neighbors:  [failed]\n");
+    }
+
+    exact.clear();
+    approximate.clear();
+    for ( int p = 0; p < num_points; ++p ) {
+        delete points[p];
+    }
+    delete random;
+}
+
+void test_least_covered() {
+    const int num_points = 500;
+
+    NoirSpace space( 1, 0, 0, 1 );
+    Random *random = new MTwist( 4357 );
+
+    std::vector<DataPoint*> points;
+    TrainingData training_data( 0 );
+    for ( int p = 0; p < num_points; ++p ) {
+        DataPoint *point = new DataPoint( p, p % 3 == 0 ? 1 : 0, &space );
+        point->set_real_coordinate( 0, random->next() );
+        points.push_back( point );
+        training_data.add( new CoveredPoint( point ) );
+    }
+
+    // Coverage on a coarse grid, so that many points share a coverage
+    bool passed = true;
+    for ( int step = 0; step < 50; ++step ) {
+        for ( int p = 0; p < num_points; ++p ) {
+            if ( random->next() < 0.2 ) {
+                double inc = 0.5*(random->next_int( 5 ) - 2);
+                training_data.increment_coverage( p, inc );
+            }
+        }
+
+        // The ranks must follow the coverage, and the order of addition
+        std::vector<std::pair<double,int> > expected;
+        for ( int p = 0; p < num_points; ++p ) {
+            if ( training_data[p]->get_color() != 0 ) continue;
+            expected.push_back( std::make_pair( 
+                                training_data.get_coverage( p ), p ) );
+        }
+        std::sort( expected.begin(), expected.end() );
+        for ( int rank = 0; rank < 40; ++rank ) {
+            if ( training_data.get_least_covered( rank ) != 
+                                    training_data[expected[rank].second] ) {
+                passed = false;
+            }
+        }
+    }
+
+    if ( passed ) {
+        fprintf(stdout,"Test least covered:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test least covered:  [failed]\n");
+    }
+
+    training_data.clear();
+    for ( int p = 0; p < num_points; ++p ) {
+        delete points[p];
+    }
+    delete random;
+}
+
+/*
+ * Checks the specified points against the subspaces added to the model
+ * since its last check, in two ranges split at the specified point, and
+ * adds the newly covered points to its registers.
+ */
+void check_incrementally( Model *model, const PointColumns &columns,
+                          const std::vector<DataPoint*> &points,
+                          const size_t &split ) {
+    size_t num_points = points.size();
+    std::vector<char> newly_covered( num_points, 0 );
+    model->begin_checking_points( num_points );
+    model->check_points( columns, 0, split, &newly_covered[0] );
+    model->check_points( columns, split, num_points, &newly_covered[split] );
+
+    int num_principal = 0;
+    int num_other = 0;
+    for ( size_t p = 0; p < num_points; ++p ) {
+        if ( !newly_covered[p] ) continue;
+        if ( points[p]->get_color() == model->get_principal_color() ) {
+            ++num_principal;
+        } else {
+            ++num_other;
+        }
+    }
+    model->commit_checked_points( num_principal, num_other );
+}
+
+void test_incremental_coverage() {
+    // The points end partway through the last word of the covered bitset,
+    // and are checked in two ranges split partway through the word before
+    const int num_points = 237;
+    const size_t split = 184;
+
+    NoirSpace space( 0, 0, 0, 3 );
+    Random *random = new MTwist( 4357 );
+
+    std::vector<DataPoint*> points;
+    std::vector<CoveredPoint*> covered_points;
+    PointColumns columns( &space );
+    double num_principal = 0.0;
+    for ( int p = 0; p < num_points; ++p ) {
+        DataPoint *point = new DataPoint( p, p % 3 == 0 ? 1 : 0, &space );
+        // The first coordinate grows with the index, and the second varies
+        // little, so that subspaces cover runs of consecutive points and
+        // grown subspaces cover whole words of the covered bitset
+        point->set_real_coordinate( 0, ( p + random->next() )/num_points );
+        point->set_real_coordinate( 1, 0.48 + 0.04*random->next() );
+        point->set_real_coordinate( 2, random->next() );
+        if ( point->get_color() == 1 ) ++num_principal;
+        points.push_back( point );
+        covered_points.push_back( new CoveredPoint( point ) );
+        columns.add( point );
+    }
+
+    Orthotope region( &space );
+    for ( int r = 0; r < space.real; ++r ) {
+        region.set_real_boundaries( r, 0.0, 1.0 );
+    }
+
+    // Two models grow in step with generators of the same seed, so they
+    // have the same subspaces. The first is checked incrementally after
+    // each step, the second from scratch.
+    OrthotopeModelFactory factory;
+    Model *incremental = factory.get_model( 1, num_principal, 
+                                            num_points - num_principal );
+    Model *scratch = factory.get_model( 1, num_principal, 
+                                        num_points - num_principal );
+    Random *incremental_random = new MTwist( 1234 );
+    Random *scratch_random = new MTwist( 1234 );
+
+    // Subspaces are added around principal color points and grown in
+    // turn, so that the word in which the second range starts is partly
+    // covered before the last subspace covers more of its points
+    bool passed = true;
+    const int nexus_points[] = { 78, 114, 180 };
+    for ( int step = 0; step < 6; ++step ) {
+        if ( step % 2 == 0 ) {
+            int nexus = nexus_points[step/2];
+            incremental->expand( region, covered_points[nexus], 
+                                 covered_points[nexus + 1], 
+                                 incremental_random, 0.12, 0.2 );
+            scratch->expand( region, covered_points[nexus], 
+                             covered_points[nexus + 1], 
+                             scratch_random, 0.12, 0.2 );
+        } else {
+            incremental->grow_last_space( region, incremental_random, 0.5 );
+            scratch->grow_last_space( region, scratch_random, 0.5 );
+        }
+
+        check_incrementally( incremental, columns, points, split );
+        scratch->clear_checked_points();
+        check_incrementally( scratch, columns, points, 0 );
+
+        if ( incremental->get_num_principal_color() != 
+                                    scratch->get_num_principal_color() ||
+             incremental->get_num_other_color() != 
+                                    scratch->get_num_other_color() ) {
+            passed = false;
+        }
+        for ( int p = 0; p < num_points; ++p ) {
+            bool covered = scratch->covers( covered_points[p] );
+            if ( incremental->is_covered_point( p ) != covered ||
+                 scratch->is_covered_point( p ) != covered ) {
+                passed = false;
+            }
+        }
+    }
+
+    // The model must neither cover nothing nor everything
+    if ( incremental->get_num_principal_color() == 0 ||
+         incremental->get_num_principal_color() == num_principal ) {
+        passed = false;
+    }
+
+    if ( passed ) {
+        fprintf(stdout,"Test incremental coverage:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test incremental coverage:  [failed]\n");
+    }
+
+    delete incremental;
+    delete scratch;
+    delete incremental_random;
+    delete scratch_random;
+    for ( int p = 0; p < num_points; ++p ) {
+        delete covered_points[p];
+        delete points[p];
+    }
+    delete random;
+}
+
+/*
+ * Points of two classes with all kinds of coordinates, some of them
+ * missing, the orthotope enclosing them and a discriminator trained on the
+ * first of them. The scored points follow the training points, and the
+ * first nominal coordinate takes the specified number of values. Models
+ * may be generated speculatively, in batches of the specified size, and
+ * the work shared out over the specified pool of threads.
+ */
+class TrainedDiscriminator {
+ public:
+    TrainedDiscriminator( const int &num_training, const int &num_scored,
+                          const int &num_nominal_values,
+                          ModelFactory *factory, const bool &least_covered,
+                          const int &batch_size = 1, 
+                          ThreadPool *thread_pool = 0 )
+        : numTraining( num_training ), numScored( num_scored ),
+          space( 2, 1, 1, 2 ), random( new MTwist( 4357 ) ), points(),
+          boundary( &space ), training(), discriminator( 1 ) {
+
+        for ( int p = 0; p < num_training + num_scored; ++p ) {
+            double x = random->next();
+            double y = random->next();
+            DataPoint *point = new DataPoint( p, x + y > 1.0 ? 1 : 0, 
+                                              &space );
+            point->set_real_coordinate( 0, x );
+            point->set_real_coordinate( 1, random->next() < 0.05 ? NAN : y );
+            point->set_nominal_coordinate( 0, 
+                                    random->next_int( num_nominal_values ) );
+            point->set_nominal_coordinate( 1, random->next() < 0.05 ? -1 : 
+                                              random->next_int( 3 ) );
+            point->set_ordinal_coordinate( 0, random->next_int( 4 )/3.0 );
+            point->set_interval_coordinate( 0, random->next() );
+            points.push_back( point );
+        }
+
+        for ( int n = 0; n < num_nominal_values; ++n ) {
+            boundary.add_nominal( 0, n );
+            boundary.add_nominal( 1, n );
+        }
+        boundary.set_ordinal_boundaries( 0, 0.0, 1.0 );
+        boundary.set_interval_boundaries( 0, 0.0, 1.0 );
+        boundary.set_real_boundaries( 0, 0.0, 1.0 );
+        boundary.set_real_boundaries( 1, 0.0, 1.0 );
+
+        for ( int p = 0; p < num_training; ++p ) {
+            training.add( points[p] );
+        }
+
+        discriminator.set_random( random );
+        if ( batch_size > 1 ) {
+            std::vector<Random*> streams;
+            for ( int b = 0; b < batch_size; ++b ) {
+                streams.push_back( new MTwist( 4358 + b ) );
+            }
+            discriminator.set_random_streams( streams );
+        }
+        discriminator.set_thread_pool( thread_pool );
+        discriminator.set_boundary( &boundary );
+        discriminator.set_upper_fraction( 0.49 );
+        discriminator.set_model_factory( factory );
+        discriminator.add_training_data( &training );
+        if ( least_covered ) {
+            discriminator.create_models_lc( 20, 10 );
+        } else {
+            discriminator.create_models_rc( 30, 10 );
+        }
+    }
+
+    ~TrainedDiscriminator() {
+        for ( size_t p = 0; p < points.size(); ++p ) {
+            delete points[p];
+        }
+        delete random;
+    }
+
+    /*
+     * Retrieve the scored point with the specified index.
+     */
+    DataPoint* scored( const int &s ) {
+        return points[numTraining + s];
+    }
+
+    /*
+     * Add the scored points to the specified columns.
+     */
+    void add_scored( PointColumns &columns ) {
+        for ( int s = 0; s < numScored; ++s ) {
+            columns.add( scored( s ) );
+        }
+    }
+
+    const int numTraining;
+    const int numScored;
+    NoirSpace space;
+    Random *random;
+    std::vector<DataPoint*> points;
+    Orthotope boundary;
+    DataStore training;
+    Discriminator discriminator;
+
+ private:
+    TrainedDiscriminator(const TrainedDiscriminator&) = delete;
+    TrainedDiscriminator& operator=(const TrainedDiscriminator&) = delete;
+};
+
+void test_batched_scoring() {
+    const int num_scored = 1300;
+    TrainedDiscriminator trained( 600, num_scored, 4, 
+                                  new OrthotopeModelFactory(), true );
+
+    // The batched scores must equal those of the points scored one by one
+    PointColumns columns( &trained.space );
+    trained.add_scored( columns );
+    std::vector<double> scores( num_scored );
+    trained.discriminator.test( columns, 0, num_scored, &scores[0] );
+
+    bool passed = true;
+    for ( int s = 0; s < num_scored; ++s ) {
+        if ( scores[s] != trained.discriminator.test( trained.scored( s ) ) ) {
+            passed = false;
+        }
+    }
+
+    if ( passed ) {
+        fprintf(stdout,"Test batched scoring:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test batched scoring:  [failed]\n");
+    }
+}
+
+void test_compiled_scoring() {
+    const int num_scored = 1300;
+    TrainedDiscriminator trained( 800, num_scored, 5, 
+                                  new OrthotopeModelFactory(), false );
+
+    // The compiled scores must equal those of the models tested one by one
+    CompiledDiscriminator compiled( trained.discriminator );
+    PointColumns columns( &trained.space );
+    trained.add_scored( columns );
+    std::vector<double> scores( num_scored );
+    compiled.test( columns, 0, num_scored, &scores[0] );
+
+    // The estimated size of the tables must bound their actual size
+    bool passed = compiled.get_num_spaces() > 0 &&
+                  compiled.get_size() > 0 &&
+                  CompiledDiscriminator::estimate_size( 
+                        trained.discriminator ) >= compiled.get_size();
+    for ( int s = 0; s < num_scored; ++s ) {
+        double expected = trained.discriminator.test( trained.scored( s ) );
+        if ( scores[s] != expected ||
+             compiled.test( trained.scored( s ) ) != expected ) {
+            passed = false;
+        }
+    }
+
+    if ( passed ) {
+        fprintf(stdout,"Test compiled scoring:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test compiled scoring:  [failed]\n");
+    }
+}
+
+void test_save_load() {
+    const int num_scored = 900;
+    const char *filename = "test_save_load.sdm";
+
+    // Discriminators of both kinds of models, once reloaded from a file,
+    // must give the same scores as those which were saved
+    bool passed = true;
+    for ( int kind = 0; kind < 2; ++kind ) {
+        TrainedDiscriminator trained( 600, num_scored, 5, kind == 0 ? 
+                                    static_cast<ModelFactory*>( 
+                                        new OrthotopeModelFactory() ) :
+                                    new BallModelFactory(), false );
+
+        BinaryWriter out( filename );
+        trained.discriminator.write( out );
+        out.close();
+
+        Discriminator loaded( 1 );
+        loaded.set_model_factory( kind == 0 ? 
+                                    static_cast<ModelFactory*>( 
+                                        new OrthotopeModelFactory() ) :
+                                    new BallModelFactory() );
+        BinaryReader in( filename );
+        loaded.read( in, &trained.space );
+
+        if ( loaded.get_models().size() != 
+                            trained.discriminator.get_models().size() ||
+             loaded.get_models().empty() ) {
+            passed = false;
+        }
+        for ( int s = 0; s < num_scored; ++s ) {
+            double expected = trained.discriminator.test( trained.scored( s ) );
+            if ( loaded.test( trained.scored( s ) ) != expected ) {
+                passed = false;
+            }
+        }
+    }
+    remove( filename );
+
+    if ( passed ) {
+        fprintf(stdout,"Test save and load:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test save and load:  [failed]\n");
+    }
+}
+
+void test_mapped_scoring() {
+    const int num_scored = 1300;
+    const char *filename = "test_mapped_scoring.sdm";
+
+    // The first nominal coordinate has more values than fit into a single
+    // word of a nominal mask
+    TrainedDiscriminator trained( 800, num_scored, 100, 
+                                  new OrthotopeModelFactory(), false );
+
+    BinaryWriter out( filename );
+    trained.discriminator.write( out );
+    out.close();
+
+    // The view scores the mapped record as the discriminator it was
+    // written from
+    bool passed = true;
+    {
+        MappedFile mapped( filename );
+        DiscriminatorView view( &trained.space, mapped.get_data(), 
+                                mapped.get_size() );
+
+        PointColumns columns( &trained.space );
+        trained.add_scored( columns );
+        std::vector<double> scores( num_scored );
+        view.test( columns, 0, num_scored, &scores[0] );
+
+        if ( view.get_num_models() != 
+                            trained.discriminator.get_models().size() ||
+             view.get_num_models() == 0 || 
+             view.get_record_size() != mapped.get_size() ) {
+            passed = false;
+        }
+        for ( int s = 0; s < num_scored; ++s ) {
+            double expected = trained.discriminator.test( trained.scored( s ) );
+            if ( scores[s] != expected ||
+                 view.test( trained.scored( s ) ) != expected ) {
+                passed = false;
+            }
+        }
+    }
+    remove( filename );
+
+    if ( passed ) {
+        fprintf(stdout,"Test mapped scoring:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test mapped scoring:  [failed]\n");
+    }
+}
+
+/*
+ * Writes a data file of two classes for learning by an SDMachine, and sets
+ * the properties by which it is read and learned.
+ */
+void write_machine_data( const char *filename, Properties &props ) {
+    Random *random = new MTwist( 4357 );
+
+    FILE *out = fopen( filename, "w" );
+    for ( int p = 0; p < 400; ++p ) {
+        double x = random->next();
+        double y = random->next();
+        double z = random->next();
+        fprintf( out, "%.6f,%.6f,%.6f,%d\n", x, y, z, x + y > 1.0 ? 1 : 0 );
+    }
+    fclose( out );
+    delete random;
+
+    props.set_property( "Data::Training::Filename", filename );
+    props.set_property( "Data::Fields::Deliminator", "," );
+    props.set_property( "Data::Fields::NumberOf", "4" );
+    props.set_property( "Data::Fields::ID", "none" );
+    props.set_property( "Data::Fields::Class", "4" );
+    props.set_property( "Data::Fields::Real", "1-3" );
+    props.set_property( "SDM::Random::Seed", "187590291" );
+    props.set_property( "SDM::Threads", "4" );
+    props.set_property( "SDM::Learning::NumberOfModels", "20" );
+    props.set_property( "SDM::Learning::NumberOfFolds", "4" );
+    props.set_property( "SDM::Learning::MaximumNumberOfSubspaces", "100" );
+    props.set_property( "SDM::Learning::EnrichmentLevel", "0.2" );
+    props.set_property( "SDM::Learning::Algorithm", "LeastCovered" );
+    props.set_property( "SDM::Model::FeatureSpace::LowerFraction", "0.0" );
+    props.set_property( "SDM::Model::FeatureSpace::UpperFraction", "0.4" );
+    props.set_property( "SDM::Model::SubspaceTypes", "Orthotopes" );
+}
+
+/*
+ * Learns the training data of the specified properties in a child process,
+ * which writes the results of learning to the specified output file and
+ * saves the discriminators. Every child starts from the random number
+ * generators of the parent, so children learning the same data with the
+ * same properties must agree.
+ */
+bool learn_in_child( Properties &props, const char *output, 
+                     const char *saved ) {
+    fflush( stdout );
+    pid_t pid = fork();
+    if ( pid == 0 ) {
+        int status = 1;
+        if ( freopen( output, "w", stdout ) != 0 ) {
+            try {
+                DataManager dataManager;
+                dataManager.init( props );
+                dataManager.load_training_data(
+                    props.get_property( "Data::Training::Filename" ) );
+                SDMachine sdm;
+                sdm.init( props );
+                sdm.learn( dataManager );
+                sdm.save( saved, dataManager );
+                status = 0;
+            } catch ( ... ) {
+            }
+            fflush( stdout );
+        }
+        _exit( status );
+    }
+
+    int status = 0;
+    return pid > 0 && waitpid( pid, &status, 0 ) == pid &&
+           WIFEXITED( status ) && WEXITSTATUS( status ) == 0;
+}
+
+/*
+ * Reads the lines of the specified file in sorted order, so the output of
+ * threads interleaved in different orders can be compared.
+ */
+bool read_sorted_lines( const char *filename, 
+                        std::vector<std::string> &lines ) {
+    FILE *in = fopen( filename, "rb" );
+    if ( in == 0 ) return false;
+    std::string line;
+    int c;
+    while ( (c = fgetc( in )) != EOF ) {
+        if ( c == '\n' ) {
+            lines.push_back( line );
+            line.clear();
+        } else {
+            line.push_back( static_cast<char>( c ) );
+        }
+    }
+    fclose( in );
+    std::sort( lines.begin(), lines.end() );
+    return true;
+}
+
+/*
+ * Whether the specified files exist and have the same lines, in any order.
+ */
+bool same_lines( const char *first, const char *second ) {
+    std::vector<std::string> first_lines;
+    std::vector<std::string> second_lines;
+    return read_sorted_lines( first, first_lines ) &&
+           read_sorted_lines( second, second_lines ) &&
+           first_lines == second_lines;
+}
+
+/*
+ * Whether the specified files exist and have the same contents.
+ */
+bool same_contents( const char *first, const char *second ) {
+    FILE *a = fopen( first, "rb" );
+    FILE *b = fopen( second, "rb" );
+    bool same = a != 0 && b != 0;
+    while ( same ) {
+        int ca = fgetc( a );
+        int cb = fgetc( b );
+        same = ca == cb;
+        if ( ca == EOF ) break;
+    }
+    if ( a != 0 ) fclose( a );
+    if ( b != 0 ) fclose( b );
+    return same;
+}
+
+void test_concurrent_folds() {
+    Properties props;
+    write_machine_data( "test_folds.csv", props );
+
+    // The folds learned one after the other and all at the same time must
+    // give the same results and keep the same discriminators
+    props.set_property( "SDM::Learning::ConcurrentFolds", "false" );
+    bool passed = learn_in_child( props, "test_serial.out", 
+                                  "test_serial.sdm" );
+    props.set_property( "SDM::Learning::ConcurrentFolds", "true" );
+    passed = learn_in_child( props, "test_concurrent.out", 
+                             "test_concurrent.sdm" ) && passed;
+
+    passed = passed && same_lines( "test_serial.out", 
+                                   "test_concurrent.out" ) &&
+                       same_contents( "test_serial.sdm", 
+                                      "test_concurrent.sdm" );
+
+    // Also when there are fewer workers than folds, so that a worker learns
+    // several folds with the same discriminators
+    props.set_property( "SDM::Threads", "3" );
+    passed = learn_in_child( props, "test_concurrent.out", 
+                             "test_concurrent.sdm" ) && passed;
+    passed = passed && same_lines( "test_serial.out", 
+                                   "test_concurrent.out" ) &&
+                       same_contents( "test_serial.sdm", 
+                                      "test_concurrent.sdm" );
+
+    remove( "test_folds.csv" );
+    remove( "test_serial.out" );
+    remove( "test_serial.sdm" );
+    remove( "test_concurrent.out" );
+    remove( "test_concurrent.sdm" );
+
+    if ( passed ) {
+        fprintf(stdout,"Test concurrent folds:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test concurrent folds:  [failed]\n");
+    }
+}
+
+/*
+ * Whether each discriminator learned for the specified properties reused
+ * its pool of covered points for the specified number of folds.
+ */
+bool pool_reused( Properties &props, const int &num_reuses ) {
+    DataManager dataManager;
+    dataManager.init( props );
+    dataManager.load_training_data(
+        props.get_property( "Data::Training::Filename" ) );
+    SDMachine sdm;
+    sdm.init( props );
+    sdm.learn( dataManager );
+
+    const std::vector<Discriminator*> &dis = sdm.get_discriminators();
+    bool reused = !dis.empty();
+    for ( size_t d = 0; d < dis.size(); ++d ) {
+        if ( dis[d]->get_training_data().get_num_pool_reuses() != 
+                                                            num_reuses ) {
+            reused = false;
+        }
+    }
+    return reused;
+}
+
+void test_fold_pool() {
+    Properties props;
+    write_machine_data( "test_pool.csv", props );
+
+    // Serial folds share one set of discriminators, which creates its pool
+    // for the first of the four folds and reuses it for the others.
+    // Concurrent folds have one set per worker, which here learns two folds.
+    props.set_property( "SDM::Learning::ConcurrentFolds", "false" );
+    bool passed = pool_reused( props, 3 );
+    props.set_property( "SDM::Learning::ConcurrentFolds", "true" );
+    props.set_property( "SDM::Threads", "2" );
+    passed = pool_reused( props, 1 ) && passed;
+
+    remove( "test_pool.csv" );
+
+    if ( passed ) {
+        fprintf(stdout,"Test fold pool:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test fold pool:  [failed]\n");
+    }
+}
+
+void test_speculative_batch() {
+    const int num_scored = 900;
+
+    // Models generated speculatively in batches must be the same, and give
+    // the same scores, whether or not the batch is shared out over threads
+    ThreadPool pool( 4 );
+    TrainedDiscriminator serial( 600, num_scored, 4, 
+                                 new OrthotopeModelFactory(), false, 4 );
+    TrainedDiscriminator threaded( 600, num_scored, 4, 
+                                   new OrthotopeModelFactory(), false, 4, 
+                                   &pool );
+
+    BinaryWriter serial_out( "test_batch_serial.sdm" );
+    serial.discriminator.write( serial_out );
+    serial_out.close();
+    BinaryWriter threaded_out( "test_batch_threaded.sdm" );
+    threaded.discriminator.write( threaded_out );
+    threaded_out.close();
+
+    bool passed = !serial.discriminator.get_models().empty() &&
+                  same_contents( "test_batch_serial.sdm", 
+                                 "test_batch_threaded.sdm" );
+    for ( int s = 0; s < num_scored; ++s ) {
+        if ( serial.discriminator.test( serial.scored( s ) ) != 
+                    threaded.discriminator.test( threaded.scored( s ) ) ) {
+            passed = false;
+        }
+    }
+
+    remove( "test_batch_serial.sdm" );
+    remove( "test_batch_threaded.sdm" );
+
+    if ( passed ) {
+        fprintf(stdout,"Test speculative batch:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test speculative batch:  [failed]\n");
+    }
+}
+
+void test_compiled_fallback() {
+    Properties props;
+    write_machine_data( "test_compiled.csv", props );
+
+    // Compiled discriminators, and discriminators too large to be compiled
+    // within the memory allowed, must give the results of those which are
+    // not compiled
+    bool passed = learn_in_child( props, "test_tested.out", 
+                                  "test_tested.sdm" );
+    props.set_property( "SDM::Scoring::Compiled", "true" );
+    passed = learn_in_child( props, "test_compiled.out", 
+                             "test_compiled.sdm" ) && passed;
+    passed = passed && same_lines( "test_tested.out", "test_compiled.out" );
+    props.set_property( "SDM::Scoring::CompiledMemory", "0" );
+    passed = learn_in_child( props, "test_compiled.out", 
+                             "test_compiled.sdm" ) && passed;
+    passed = passed && same_lines( "test_tested.out", "test_compiled.out" );
+
+    remove( "test_compiled.csv" );
+    remove( "test_tested.out" );
+    remove( "test_tested.sdm" );
+    remove( "test_compiled.out" );
+    remove( "test_compiled.sdm" );
+
+    if ( passed ) {
+        fprintf(stdout,"Test compiled fallback:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test compiled fallback:  [failed]\n");
+    }
+}
+
+/*
+ * Writes a copy of the specified file, in which the specified number of
+ * bytes from the specified offset are replaced.
+ */
+void write_altered_copy( const char *filename, const char *copy,
+                         const long &offset, const void *bytes, 
+                         const size_t &num_bytes ) {
+    std::vector<char> contents;
+    FILE *in = fopen( filename, "rb" );
+    int c;
+    while ( in != 0 && (c = fgetc( in )) != EOF ) {
+        contents.push_back( static_cast<char>( c ) );
+    }
+    if ( in != 0 ) fclose( in );
+
+    if ( contents.size() >= offset + num_bytes ) {
+        memcpy( &contents[offset], bytes, num_bytes );
+    }
+
+    FILE *out = fopen( copy, "wb" );
+    fwrite( contents.data(), 1, contents.size(), out );
+    fclose( out );
+}
+
+/*
+ * Whether an SDMachine refuses to load the specified file for data of the
+ * specified properties.
+ */
+bool load_fails( Properties &props, const char *filename ) {
+    try {
+        DataManager dataManager;
+        dataManager.init( props );
+        SDMachine sdm;
+        sdm.init( props );
+        sdm.load( filename, dataManager );
+    } catch ( util::InvalidInputError &error ) {
+        return true;
+    }
+    return false;
+}
+
+void test_machine_save_load() {
+    Properties props;
+    write_machine_data( "test_machine.csv", props );
+    props.set_property( "SDM::Learning::ConcurrentFolds", "true" );
+
+    bool passed = learn_in_child( props, "test_machine.out", 
+                                  "test_machine.sdm" );
+
+    // The loaded discriminators and scales, saved again, must give the
+    // file they were loaded from
+    try {
+        DataManager dataManager;
+        dataManager.init( props );
+        SDMachine sdm;
+        sdm.init( props );
+        sdm.load( "test_machine.sdm", dataManager );
+        sdm.save( "test_machine_again.sdm", dataManager );
+    } catch ( std::exception &error ) {
+        passed = false;
+    }
+    passed = passed && same_contents( "test_machine.sdm", 
+                                      "test_machine_again.sdm" );
+
+    // Files of another format, or of another version of it, must be refused
+    const char magic[8] = { 'N', 'O', 'T', 'S', 'D', 'M', 'S', '!' };
+    write_altered_copy( "test_machine.sdm", "test_machine_bad.sdm", 
+                        0, magic, sizeof(magic) );
+    passed = passed && load_fails( props, "test_machine_bad.sdm" );
+
+    const int64_t version = 99;
+    write_altered_copy( "test_machine.sdm", "test_machine_bad.sdm", 
+                        sizeof(magic), &version, sizeof(version) );
+    passed = passed && load_fails( props, "test_machine_bad.sdm" );
+
+    // And so must discriminators learned on fields other than those of
+    // the data
+    props.set_property( "Data::Fields::Real", "1-2" );
+    props.set_property( "Data::Fields::Interval", "3" );
+    props.set_property( "Data::Fields::Period::3", "1.0" );
+    passed = passed && load_fails( props, "test_machine.sdm" );
+
+    remove( "test_machine.csv" );
+    remove( "test_machine.out" );
+    remove( "test_machine.sdm" );
+    remove( "test_machine_again.sdm" );
+    remove( "test_machine_bad.sdm" );
+
+    if ( passed ) {
+        fprintf(stdout,"Test machine save and load:  [passed]\n");
+    } else {
+        fprintf(stdout,"Test machine save and load:  [failed]\n");
+    }
 }
 
 int main(int argc, char * argv[])
@@ -199,4 +1675,153 @@ int main(int argc, char * argv[])
 
     fprintf(stdout,"Time for to_numeric: %10.3f  %10.3f \n", real,cpu);
 
+    fprintf(stdout,"Testing ThreadPool...\n");
+
+    timer.elapsed(real,cpu);
+    test_thread_pool();
+    timer.elapsed(real,cpu);
+
+    fprintf(stdout,"Time for ThreadPool: %10.3f  %10.3f \n", real,cpu);
+
+    fprintf(stdout,"Testing PointColumns...\n");
+
+    timer.elapsed(real,cpu);
+    test_point_columns();
+    timer.elapsed(real,cpu);
+
+    fprintf(stdout,"Time for PointColumns: %10.3f  %10.3f \n", real,cpu);
+
+    fprintf(stdout,"Testing norm symmetry...\n");
+
+    timer.elapsed(real,cpu);
+    test_norm_symmetry();
+    timer.elapsed(real,cpu);
+
+    fprintf(stdout,"Time for norm symmetry: %10.3f  %10.3f \n", real,cpu);
+
+    fprintf(stdout,"Testing VPTree...\n");
+
+    timer.elapsed(real,cpu);
+    test_vp_tree();
+    timer.elapsed(real,cpu);
+
+    fprintf(stdout,"Time for VPTree: %10.3f  %10.3f \n", real,cpu);
+
+    fprintf(stdout,"Testing nearest neighbors...\n");
+
+    timer.elapsed(real,cpu);
+    test_nearest_neighbors();
+    timer.elapsed(real,cpu);
+
+    fprintf(stdout,"Time for nearest neighbors: %10.3f  %10.3f \n", real,cpu);
+
+    fprintf(stdout,"Testing nearest neighbor cache...\n");
+
+    timer.elapsed(real,cpu);
+    test_nn_cache();
+    timer.elapsed(real,cpu);
+
+    fprintf(stdout,"Time for nearest neighbor cache: %10.3f  %10.3f \n", 
+                   real,cpu);
+
+    fprintf(stdout,"Testing least covered...\n");
+
+    timer.elapsed(real,cpu);
+    test_least_covered();
+    timer.elapsed(real,cpu);
+
+    fprintf(stdout,"Time for least covered: %10.3f  %10.3f \n", real,cpu);
+
+    fprintf(stdout,"Testing incremental coverage...\n");
+
+    timer.elapsed(real,cpu);
+    test_incremental_coverage();
+    timer.elapsed(real,cpu);
+
+    fprintf(stdout,"Time for incremental coverage: %10.3f  %10.3f \n", 
+                   real,cpu);
+
+    fprintf(stdout,"Testing approximate nearest neighbors...\n");
+
+    timer.elapsed(real,cpu);
+    test_approximate_nn();
+    timer.elapsed(real,cpu);
+
+    fprintf(stdout,"Time for approximate nearest neighbors: %10.3f  %10.3f \n",
+                   real,cpu);
+
+    fprintf(stdout,"Testing batched scoring...\n");
+
+    timer.elapsed(real,cpu);
+    test_batched_scoring();
+    timer.elapsed(real,cpu);
+
+    fprintf(stdout,"Time for batched scoring: %10.3f  %10.3f \n", real,cpu);
+
+    fprintf(stdout,"Testing compiled scoring...\n");
+
+    timer.elapsed(real,cpu);
+    test_compiled_scoring();
+    timer.elapsed(real,cpu);
+
+    fprintf(stdout,"Time for compiled scoring: %10.3f  %10.3f \n", real,cpu);
+
+    fprintf(stdout,"Testing save and load...\n");
+
+    timer.elapsed(real,cpu);
+    test_save_load();
+    timer.elapsed(real,cpu);
+
+    fprintf(stdout,"Time for save and load: %10.3f  %10.3f \n", real,cpu);
+
+    fprintf(stdout,"Testing mapped scoring...\n");
+
+    timer.elapsed(real,cpu);
+    test_mapped_scoring();
+    timer.elapsed(real,cpu);
+
+    fprintf(stdout,"Time for mapped scoring: %10.3f  %10.3f \n", real,cpu);
+
+    fprintf(stdout,"Testing speculative batch...\n");
+
+    timer.elapsed(real,cpu);
+    test_speculative_batch();
+    timer.elapsed(real,cpu);
+
+    fprintf(stdout,"Time for speculative batch: %10.3f  %10.3f \n", real,cpu);
+
+    fprintf(stdout,"Testing concurrent folds...\n");
+
+    timer.elapsed(real,cpu);
+    test_concurrent_folds();
+    timer.elapsed(real,cpu);
+
+    fprintf(stdout,"Time for concurrent folds: %10.3f  %10.3f \n", real,cpu);
+
+    fprintf(stdout,"Testing compiled fallback...\n");
+
+    timer.elapsed(real,cpu);
+    test_compiled_fallback();
+    timer.elapsed(real,cpu);
+
+    fprintf(stdout,"Time for compiled fallback: %10.3f  %10.3f \n", 
+                   real,cpu);
+
+    fprintf(stdout,"Testing fold pool...\n");
+
+    timer.elapsed(real,cpu);
+    test_fold_pool();
+    timer.elapsed(real,cpu);
+
+    fprintf(stdout,"Time for fold pool: %10.3f  %10.3f \n", real,cpu);
+
+    fprintf(stdout,"Testing machine save and load...\n");
+
+    timer.elapsed(real,cpu);
+    test_machine_save_load();
+    timer.elapsed(real,cpu);
+
+    fprintf(stdout,"Time for machine save and load: %10.3f  %10.3f \n", 
+            real,cpu);
+
 }